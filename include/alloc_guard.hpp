@@ -0,0 +1,55 @@
+/**
+ * @file alloc_guard.hpp
+ * @brief Debug check that a thread's steady state never touches the heap.
+ *
+ * Built with -DORDERBOOK_ALLOC_GUARD (`make alloc_guard=1` after a clean, or
+ * the unit_tests_alloc_guard target), alloc_guard.cpp replaces the global
+ * operator new/delete. While an AllocationGuard lives on a thread, every
+ * allocation from that thread either aborts with the requested size (the
+ * default) or is counted. Other threads are not affected. Without the flag
+ * the guard is an empty object and the allocator is the standard one.
+ *
+ * MatchingEngine arms an aborting guard on its thread when its book has been
+ * warmed up (Orderbook::warm_up), so a debug run proves the matching path
+ * allocation-free.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ORDERBOOK_ALLOC_GUARD
+inline constexpr bool ALLOC_GUARD_ENABLED = true;
+#else
+inline constexpr bool ALLOC_GUARD_ENABLED = false;
+#endif
+
+class AllocationGuard {
+public:
+    enum class Mode : uint8_t {
+        abort, // сообщение в stderr и abort()
+        count  // только счётчик — для тестов
+    };
+
+#ifdef ORDERBOOK_ALLOC_GUARD
+    explicit AllocationGuard(Mode mode = Mode::abort);
+    ~AllocationGuard();
+    // Allocations counted on this thread since the guard was created
+    size_t allocations() const;
+#else
+    explicit AllocationGuard(Mode = Mode::abort) {}
+    size_t allocations() const { return 0; }
+#endif
+
+    AllocationGuard(const AllocationGuard&) = delete;
+    AllocationGuard& operator=(const AllocationGuard&) = delete;
+
+private:
+#ifdef ORDERBOOK_ALLOC_GUARD
+    // Вложенные охранники: внешний режим восстанавливается в деструкторе
+    bool m_was_armed;
+    Mode m_was_mode;
+    size_t m_start;
+#endif
+};
@@ -0,0 +1,43 @@
+/**
+ * @file book_manager.hpp
+ * @brief Hosts many order books in one process, keyed by dense symbol ID.
+ *
+ * Every book is sized by its own BookConfig (tick size, price band, pool
+ * capacity), and all of them — the Orderbook objects, their level arrays,
+ * bitmaps and order pools — are carved out of one shared monotonic arena, so
+ * thousands of small books cost what they use rather than 200k levels apiece.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "orderbook.hpp"
+
+class BookManager {
+public:
+    // `upstream` supplies the arena's chunks; `initial_arena_bytes` is the first chunk size
+    explicit BookManager(size_t initial_arena_bytes = 64 << 20,
+                         std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~BookManager();
+
+    BookManager(const BookManager&) = delete;
+    BookManager& operator=(const BookManager&) = delete;
+
+    // Creates the book for `symbol`; throws if it already exists.
+    // Not thread-safe: create all books before handing them to matching threads.
+    Orderbook& create_book(uint32_t symbol, const BookConfig& config);
+
+    // nullptr if no book was created for this symbol
+    Orderbook* find(uint32_t symbol) {
+        return symbol < m_books.size() ? m_books[symbol] : nullptr;
+    }
+
+    size_t book_count() const { return m_book_count; }
+
+private:
+    std::pmr::monotonic_buffer_resource m_arena;
+    std::vector<Orderbook*> m_books; // индекс — ID символа
+    size_t m_book_count = 0;
+};
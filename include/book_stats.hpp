@@ -0,0 +1,69 @@
+/**
+ * @file book_stats.hpp
+ * @brief Hot-path counters of one book, compiled in with -DORDERBOOK_STATS.
+ *
+ * The book is owned by one matching thread, which is the only writer: every
+ * update is a relaxed load plus a relaxed store (plain movs, no lock-prefixed
+ * read-modify-write). A monitoring thread reads them through
+ * Orderbook::stats() with relaxed loads and never blocks the writer; each
+ * counter is exact, the set is not one atomic snapshot. The counters fill
+ * their own cache line, so the reader only contends for that line.
+ * Without ORDERBOOK_STATS every call is an empty inline and reads return 0.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Снимок для мониторинга (Orderbook::stats)
+struct BookStats {
+    uint64_t orders_added = 0;      // встало в книгу (включая остатки лимиток)
+    uint64_t orders_filled = 0;     // мейкеров исполнено полностью
+    uint64_t orders_cancelled = 0;
+    uint64_t rejects = 0;           // FOK без объёма, пересекающий post-only
+    uint64_t aggressive_orders = 0; // ордеров, исполнившихся хотя бы на одном уровне
+    uint64_t levels_swept = 0;      // сумма уровней по агрессивным ордерам
+    uint64_t max_levels_swept = 0;
+    uint64_t max_fifo_depth = 0;    // самая длинная очередь уровня
+    // Из пула; ведутся и без ORDERBOOK_STATS
+    uint64_t pool_in_use = 0;
+    uint64_t pool_high_water = 0;
+};
+
+#ifdef ORDERBOOK_STATS
+class alignas(64) BookCounters {
+#else
+class BookCounters {
+#endif
+public:
+    enum Counter {
+        orders_added, orders_filled, orders_cancelled, rejects,
+        aggressive_orders, levels_swept, max_levels_swept, max_fifo_depth,
+        COUNTER_COUNT
+    };
+
+#ifdef ORDERBOOK_STATS
+    static constexpr bool enabled = true;
+
+    void add(Counter c, uint64_t n = 1) {
+        auto& v = m_values[c];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void raise(Counter c, uint64_t value) {
+        auto& v = m_values[c];
+        if (value > v.load(std::memory_order_relaxed)) v.store(value, std::memory_order_relaxed);
+    }
+    uint64_t get(Counter c) const { return m_values[c].load(std::memory_order_relaxed); }
+
+private:
+    std::array<std::atomic<uint64_t>, COUNTER_COUNT> m_values{};
+#else
+    static constexpr bool enabled = false;
+
+    void add(Counter, uint64_t = 1) {}
+    void raise(Counter, uint64_t) {}
+    uint64_t get(Counter) const { return 0; }
+#endif
+};
@@ -0,0 +1,45 @@
+/**
+ * @file command.hpp
+ * @brief Fixed-size command and result records passed to and from the book.
+ *
+ * Commands are plain trivially-copyable structs so they can be moved through
+ * lock-free rings by value, without allocation.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "enums.hpp"
+
+enum class CommandType : uint8_t {
+    order,  // handle_order(order_type, quantity, side, price_cents, tif, display_quantity)
+    modify, // modify_order(order_id, quantity)
+    cancel, // delete_order(order_id)
+    replace, // replace_order(order_id, quantity, price_cents)
+    mass_cancel, // cancel_all([owner,] side: buy — bid, sell — ask; both_sides — обе)
+    checkpoint  // книгу не меняет; order_id — digest() первичной книги в этой точке журнала
+};
+
+struct Command {
+    uint64_t seq = 0;       // клиентский номер, возвращается в Result
+    uint64_t order_id = 0;  // для modify/cancel/replace; у checkpoint — digest
+    int32_t price_cents = 0;
+    int quantity = 0;
+    CommandType type = CommandType::order;
+    OrderType order_type = OrderType::limit;
+    Side side = Side::buy;
+    TimeInForce tif = TimeInForce::gtc;
+    int display_quantity = 0; // > 0 — айсберг: видно не больше стольких
+    // Сессия: её ордера снимает cancel_all(owner); mass_cancel, modify, cancel
+    // и replace с owner трогают только её ордера (чужой ID — ok = false)
+    uint32_t owner = 0;
+    bool both_sides = false; // mass_cancel: обе стороны одной командой, side не читается
+};
+
+struct Result {
+    uint64_t seq = 0;
+    uint64_t order_id = 0;  // ID остатка лимитки (или заменённого ордера), оставшегося в книге (0 — не встал)
+    int units_transacted = 0;
+    int64_t total_value = 0; // нотионал в центах
+    bool ok = false;        // modify/cancel/replace нашли ордер; order — не отклонён (fok/post_only); checkpoint — digest совпал
+};
@@ -0,0 +1,42 @@
+/**
+ * @file depth_scan.hpp
+ * @brief Cumulative size over runs of contiguous price levels, vectorized.
+ *
+ * The level headers of a ladder's window are one contiguous array, so "how
+ * much rests between here and there" is a streaming sum over quantity +
+ * reserve with no per-order work. scan_levels() walks a run from `start`
+ * towards higher (or, with `descending`, lower) addresses and stops before
+ * the first level that would bring the sum to `cap`. Besides the total it
+ * returns the sum of size x distance from `start`, from which the caller
+ * derives the notional exactly: price is affine in the distance.
+ *
+ * The kernel is picked once at startup: AVX-512F (8 levels per step), AVX2
+ * (4), or scalar. All three return identical results.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "price_ladder.hpp"
+
+struct LevelScan {
+    size_t levels = 0;     // уровней, целиком вошедших в сумму
+    int64_t quantity = 0;  // их quantity + reserve
+    int64_t weighted = 0;  // сумма объём_i * i, i — расстояние от start в уровнях
+};
+
+// Levels start, start±1, ... start±(n-1); level `levels` (if < n) is the one that reaches cap
+LevelScan scan_levels(const PriceLevel* start, size_t n, bool descending, int64_t cap);
+LevelScan scan_levels_scalar(const PriceLevel* start, size_t n, bool descending, int64_t cap);
+
+// "avx512", "avx2" or "scalar" — the kernel scan_levels dispatches to
+const char* scan_levels_isa();
+
+// Every kernel this CPU can run, best first and scalar last (tests, benchmarks)
+struct ScanKernel {
+    const char* isa;
+    LevelScan (*fn)(const PriceLevel* start, size_t n, bool descending, int64_t cap);
+};
+std::span<const ScanKernel> scan_kernels();
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+
 enum class BookSide {bid, ask};
 enum class Side {buy, sell};
 enum class OrderType {market, limit};
+// gtc — остаток встаёт в книгу; ioc — остаток отменяется; fok — всё или ничего;
+// post_only — только встать, при пересечении спреда отклоняется
+enum class TimeInForce : uint8_t {gtc, ioc, fok, post_only};
@@ -0,0 +1,55 @@
+/**
+ * @file events.hpp
+ * @brief Execution reports emitted by the matching path.
+ *
+ * The book is parameterized on an event sink at compile time: NullSink
+ * compiles every emit away, EventRing stores events in a preallocated SPSC
+ * ring for a consumer on the same or another thread. Neither allocates.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "enums.hpp"
+#include "spsc_ring.hpp"
+
+enum class EventType : uint8_t {
+    fill,         // resting order fully executed
+    partial_fill, // resting order partially executed, remains in the book
+    rest,         // (residual of) an order was added to the book
+    cancel,       // resting order removed by delete_order
+    modify,       // resting order quantity changed by modify_order, or quantity/price by replace_order
+    reject,       // order refused without touching the book (FOK shortfall, post-only cross)
+    refresh       // iceberg showed a new slice of its reserve and moved to the back of its level
+};
+
+struct ExecEvent {
+    uint64_t maker_id = 0;   // resting order; for rest/cancel/modify/refresh — the order itself, 0 for reject
+    uint64_t taker_id = 0;   // aggressive order, 0 for market/IOC/FOK orders and non-fill events
+    int32_t price_cents = 0; // price in ticks
+    int quantity = 0;        // executed / rested / cancelled / new / rejected quantity
+    EventType type = EventType::fill;
+    BookSide side = BookSide::bid; // side of the resting order (for reject — the side it would rest on)
+};
+
+// Discards everything; calls are inlined away
+struct NullSink {
+    void on_event(const ExecEvent&) {}
+};
+
+// Preallocated ring of events; counts events dropped when the consumer lags
+class EventRing {
+public:
+    explicit EventRing(size_t capacity) : m_ring(capacity) {}
+
+    void on_event(const ExecEvent& event) {
+        if (!m_ring.try_push(event)) ++m_dropped;
+    }
+
+    bool try_pop(ExecEvent& out) { return m_ring.try_pop(out); }
+    uint64_t dropped() const { return m_dropped; }
+
+private:
+    SpscRing<ExecEvent> m_ring;
+    uint64_t m_dropped = 0;
+};
@@ -0,0 +1,110 @@
+/**
+ * @file flow_generator.hpp
+ * @brief Synthetic order flow shaped like a real feed, generated up front.
+ *
+ * Most adds land within a few ticks of the touch, the rest spread deep into
+ * the book; cancels dominate after adds, with some size-down modifies and
+ * small marketable orders. The mid drifts in a slow random walk.
+ *
+ * The stream is run through a probe book while it is generated, so every
+ * cancel and modify names an order that is live at that point. Slots are
+ * assigned deterministically, so the IDs hold for any book with the same
+ * BookConfig that starts empty.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "command.hpp"
+#include "orderbook.hpp"
+
+struct FlowConfig {
+    size_t messages = 2'000'000;
+    uint64_t seed = 42;
+    int32_t mid_price_cents = 10000;
+    // Доли типов сообщений (нормируются): add / cancel / modify / market
+    double add_weight = 0.50;
+    double cancel_weight = 0.38;
+    double modify_weight = 0.07;
+    double market_weight = 0.05;
+    double near_touch = 0.90;  // доля добавлений у касания
+    int near_ticks = 5;        // «у касания» — столько тиков от середины
+    int far_ticks = 500;       // остальные — равномерно до стольких
+};
+
+inline std::vector<Command> generate_flow(const FlowConfig& flow, const BookConfig& book_config = BookConfig{}) {
+    std::vector<Command> commands;
+    commands.reserve(flow.messages);
+
+    std::mt19937_64 rng(flow.seed);
+    std::discrete_distribution<int> kind({flow.add_weight, flow.cancel_weight, flow.modify_weight, flow.market_weight});
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::geometric_distribution<int> near(3.0 / std::max(flow.near_ticks, 1));
+    std::uniform_int_distribution<int> far(flow.near_ticks, std::max(flow.far_ticks, flow.near_ticks));
+    std::uniform_int_distribution<int> lot(1, 10);
+
+    Orderbook probe(book_config);
+    std::vector<uint64_t> live;
+    int32_t mid = flow.mid_price_cents;
+
+    auto pick_live = [&](Command& cmd) {
+        // Снятые встречными исполнениями ID отбрасываем, пока не найдём живой
+        while (!live.empty()) {
+            size_t k = rng() % live.size();
+            cmd.order_id = live[k];
+            if (cmd.type == CommandType::cancel) {
+                live[k] = live.back();
+                live.pop_back();
+            }
+            if (probe.execute(cmd).ok) return true;
+            if (cmd.type == CommandType::modify) {
+                live[k] = live.back();
+                live.pop_back();
+            }
+        }
+        return false;
+    };
+
+    while (commands.size() < flow.messages) {
+        Command cmd;
+        cmd.seq = commands.size();
+        cmd.side = (rng() & 1) ? Side::buy : Side::sell;
+
+        switch (kind(rng)) {
+        case 1:
+            cmd.type = CommandType::cancel;
+            if (!pick_live(cmd)) continue;
+            commands.push_back(cmd);
+            continue;
+        case 2:
+            cmd.type = CommandType::modify;
+            cmd.quantity = lot(rng);
+            if (!pick_live(cmd)) continue;
+            commands.push_back(cmd);
+            continue;
+        case 3:
+            cmd.order_type = OrderType::market;
+            cmd.quantity = lot(rng) * 10;
+            break;
+        default: {
+            int offset = unit(rng) < flow.near_touch ? std::min(near(rng), flow.near_ticks - 1) : far(rng);
+            int32_t tick = book_config.tick_size;
+            cmd.price_cents = (cmd.side == Side::buy) ? mid - tick * (1 + offset) : mid + tick * offset;
+            cmd.price_cents = std::clamp(cmd.price_cents, book_config.min_price_cents, book_config.max_price_cents);
+            cmd.quantity = lot(rng) * 100;
+            break;
+        }
+        }
+
+        Result result = probe.execute(cmd);
+        if (result.order_id) live.push_back(result.order_id);
+        commands.push_back(cmd);
+
+        // Середина медленно блуждает
+        if ((commands.size() & 1023) == 0) mid += book_config.tick_size * static_cast<int32_t>(rng() % 3) - book_config.tick_size;
+    }
+    return commands;
+}
@@ -6,6 +6,25 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include "latency_histogram.hpp"
+#include "tsc_clock.hpp"
+
+// Размер кэш-линии для выравнивания разделяемых между потоками полей
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Подсказка CPU внутри спин-циклов ожидания
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Pin the calling thread to a CPU; returns false if cpu < 0 or pinning failed
+bool pin_current_thread(int cpu);
 
 inline uint64_t unix_time() {
     return std::chrono::duration_cast<std::chrono::nanoseconds>(
@@ -15,25 +34,26 @@ inline uint64_t unix_time() {
 
 void print_file_contents(std::string_view file_path);
 
-void print_fill(std::pair<int, double> fill, int quantity, u_int64_t start_time, u_int64_t end_time);
+// fill = (units, notional in cents); converted to dollars only here
+void print_fill(std::pair<int, int64_t> fill, int quantity, u_int64_t start_time, u_int64_t end_time);
+
+// Records the lifetime of a scope, in ns, into a histogram: two TSC reads
+// and an increment, nothing allocated or printed
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram) : m_histogram(histogram), m_start(tsc_now()) {}
+    ~ScopedTimer() { m_histogram.record(TscClock::to_ns(tsc_now() - m_start)); }
 
-#include <iostream>
-#include <functional>
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
 
-// Defer helper to run a function at scope exit
-struct Defer {
-    std::function<void()> f;
-    ~Defer() { f(); }
-    Defer(std::function<void()> f_) : f(f_) {}
+private:
+    LatencyHistogram& m_histogram;
+    uint64_t m_start;
 };
 
-// Macro to profile scope in nanoseconds
-#define PROFILE_SCOPE(name_str) \
-    auto start_time = std::chrono::high_resolution_clock::now(); \
-    auto end_scope = [&]() { \
-        auto end_time = std::chrono::high_resolution_clock::now(); \
-        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count(); \
-        std::cout << name_str << " took " << duration << "ns\n"; \
-    }; \
-    Defer end_defer(end_scope);
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Time the rest of the enclosing scope into `histogram`
+#define PROFILE_SCOPE(histogram) ScopedTimer PROFILE_CONCAT(profile_scope_, __LINE__)(histogram)
 
@@ -0,0 +1,65 @@
+/**
+ * @file huge_page_resource.hpp
+ * @brief Pre-faulted, optionally locked arena backed by huge pages.
+ *
+ * The whole arena is mapped once at construction: first with MAP_HUGETLB
+ * (reserved 2 MB or 1 GB pages), then as a 2 MB-aligned anonymous mapping
+ * with madvise(MADV_HUGEPAGE) for transparent huge pages, and finally as
+ * plain pages if neither is available. Every page is touched up front, so
+ * the trading path never takes a first-touch page fault, and mlock can pin
+ * it in RAM.
+ *
+ * Allocation is a bump pointer and deallocation is a no-op, like
+ * monotonic_buffer_resource. Requests that no longer fit go to `upstream`
+ * and are counted, so an undersized arena degrades instead of failing.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+class HugePageResource : public std::pmr::memory_resource {
+public:
+    enum class Backing { hugetlb, transparent, normal };
+
+    struct Options {
+        bool use_1gb_pages = false; // MAP_HUGE_1GB вместо 2 MB для MAP_HUGETLB
+        bool prefault = true;       // коснуться каждой страницы в конструкторе
+        bool lock = false;          // mlock всей арены
+    };
+
+    HugePageResource(size_t bytes, Options options,
+                     std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    explicit HugePageResource(size_t bytes) : HugePageResource(bytes, Options{}) {}
+    ~HugePageResource() override;
+
+    HugePageResource(const HugePageResource&) = delete;
+    HugePageResource& operator=(const HugePageResource&) = delete;
+
+    Backing backing() const { return m_backing; }
+    const char* backing_name() const;
+    bool locked() const { return m_locked; }
+
+    size_t capacity() const { return m_size; }
+    size_t used() const { return m_used; }
+    // Bytes that did not fit and were served by upstream
+    size_t overflow_bytes() const { return m_overflow_bytes; }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* m_upstream;
+    char* m_base = nullptr;
+    size_t m_size = 0;    // отображённый размер (кратен размеру страницы)
+    size_t m_used = 0;
+    size_t m_overflow_bytes = 0;
+    void* m_map = nullptr; // исходное отображение (для munmap)
+    size_t m_map_size = 0;
+    Backing m_backing = Backing::normal;
+    bool m_locked = false;
+};
@@ -0,0 +1,142 @@
+/**
+ * @file journal.hpp
+ * @brief Write-ahead journal of commands in a preallocated, memory-mapped file.
+ *
+ * The file is a 64-byte header followed by fixed-size records, one Command
+ * each. It is sized and allocated on disk up front and mapped MAP_SHARED,
+ * so an append is one record copy plus a count update in the mapping, with
+ * no syscall. Every `sync_interval` appends the newly written pages are handed
+ * to the kernel with msync(MS_ASYNC). A crash of the process loses nothing
+ * that was appended (the pages live in the page cache); a crash of the host
+ * loses at most what was not yet written back.
+ *
+ * Commands are journaled before they are applied, in the order they are
+ * applied, so record i + 1 is replication sequence number i + 1. Because slots, and so
+ * order IDs, are assigned deterministically, replaying the journal into a
+ * book built with the same BookConfig reproduces the same book, IDs
+ * included, and the modify/cancel records resolve to the same orders.
+ *
+ * The header keeps the settings of the writer's BookConfig that decide what
+ * a command does (band, tick, cancel policy, compaction, pool limit), so a
+ * replay builds its book from them instead of trusting the command line.
+ * MatchingEngine::set_journal records them; pool_capacity, window_ticks and
+ * prefetch_distance only shape memory and are left to the reader.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include "command.hpp"
+
+class Orderbook;
+struct BookConfig;
+
+static_assert(std::is_trivially_copyable_v<Command>, "journal records are raw Command bytes");
+
+struct JournalHeader {
+    char magic[8];          // "OBJRNL01"
+    uint32_t version;
+    uint32_t record_size;   // sizeof(Command) у записавшего
+    uint64_t capacity;      // записей помещается в файл
+    uint64_t count;         // записей записано
+    // Настройки книги, от которых зависит исход команд; recorded == 0 — не записаны
+    struct Book {
+        int32_t min_price_cents;
+        int32_t max_price_cents;
+        int32_t tick_size;
+        uint32_t compact_percent;
+        uint64_t max_pool_capacity;
+        uint8_t cancel_policy;
+        uint8_t recorded;
+        uint8_t reserved[6];
+    } book;
+};
+static_assert(sizeof(JournalHeader) == 64, "journal header is one cache line");
+
+class Journal {
+public:
+    struct Options {
+        size_t sync_interval = 4096; // записей между msync(MS_ASYNC), 0 — только sync()
+    };
+
+    // Opens `path`, creating it with room for `capacity` records, or
+    // continues an existing journal after its last record (growing it to
+    // `capacity` if it is smaller). Throws std::system_error on I/O errors
+    // and std::runtime_error on a file that is not a journal.
+    Journal(const std::string& path, size_t capacity, Options options);
+    Journal(const std::string& path, size_t capacity) : Journal(path, capacity, Options{}) {}
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Returns false (and writes nothing) when the journal is full
+    bool append(const Command& cmd) {
+        uint64_t count = m_header->count;
+        if (count == m_header->capacity) return false;
+        m_records[count] = cmd;
+        // Запись видна читателю (JournalReader::refresh) не раньше счётчика
+        std::atomic_ref<uint64_t>(m_header->count).store(count + 1, std::memory_order_release);
+        if (m_options.sync_interval && ++m_unsynced >= m_options.sync_interval) flush();
+        return true;
+    }
+
+    // Starts write-back of everything appended since the last flush (MS_ASYNC)
+    void flush();
+    // Blocks until everything appended is on disk (MS_SYNC)
+    void sync();
+    // Faults in the pages the next `records` appends will write, so the
+    // first ones after the open do not each take a page fault
+    void warm_up(size_t records);
+
+    // Stamps the writer's BookConfig into the header. Throws
+    // std::runtime_error if the journal already carries a different one.
+    void record_book_config(const BookConfig& config);
+
+    size_t size() const { return m_header->count; }
+    size_t capacity() const { return m_header->capacity; }
+    std::span<const Command> records() const { return {m_records, size()}; }
+
+private:
+    void map(size_t capacity);
+
+    int m_fd = -1;
+    void* m_map = nullptr;
+    size_t m_map_size = 0;
+    JournalHeader* m_header = nullptr;
+    Command* m_records = nullptr;
+    Options m_options;
+    size_t m_unsynced = 0;
+    size_t m_synced_count = 0; // записи до этой уже отданы msync
+};
+
+// Read-only view of a journal file, mapped for replay. The journal may still
+// be written by another process: refresh() picks up what it appended since.
+class JournalReader {
+public:
+    explicit JournalReader(const std::string& path);
+    ~JournalReader();
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    std::span<const Command> records() const { return m_records; }
+    // Re-reads the record count (up to what the mapping covers); returns records().size()
+    size_t refresh();
+    // Overwrites the recorded settings in `config`; false if the writer recorded none
+    bool book_config(BookConfig& config) const;
+
+private:
+    void* m_map = nullptr;
+    size_t m_map_size = 0;
+    std::span<const Command> m_records;
+};
+
+// Applies the records to `book` in journal order (Orderbook::apply_in_order),
+// straight from the mapping. Returns the number of commands applied.
+size_t replay_journal(std::span<const Command> records, Orderbook& book);
@@ -0,0 +1,104 @@
+/**
+ * @file latency_histogram.hpp
+ * @brief HDR-style log-linear latency histogram with O(1) recording.
+ *
+ * Values below 128 get a bucket each; above that every power of two is split
+ * into 64 linear sub-buckets, so any recorded value is reported within 1/64
+ * (about 1.6%) of itself across the whole uint64 range. Recording is an index
+ * computation and an increment: no allocation, no sorting, nothing printed.
+ *
+ * write() dumps the raw counts in a small binary format read by
+ * plot_dists.py: 8-byte magic "OBHIST01", uint32 sub-bucket bits, uint32
+ * bucket count, uint64 total/min/max, then bucket_count uint64 counts, all
+ * little-endian.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 7;
+    static constexpr size_t SUB_COUNT = size_t{1} << SUB_BITS;
+    static constexpr size_t HALF = SUB_COUNT / 2;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS) * HALF + SUB_COUNT;
+
+    void record(uint64_t value) {
+        ++m_counts[index_of(value)];
+        ++m_total;
+        m_sum += value;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) m_counts[i] += other.m_counts[i];
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    void reset() { *this = LatencyHistogram{}; }
+
+    uint64_t count() const { return m_total; }
+    uint64_t min() const { return m_total ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_total ? static_cast<double>(m_sum) / m_total : 0.0; }
+
+    // Значение, которого не превышает доля q записей (0 <= q <= 1)
+    uint64_t percentile(double q) const {
+        if (m_total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * m_total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) return std::min(highest_in(i), m_max);
+        }
+        return m_max;
+    }
+
+    bool write(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        uint32_t sub_bits = SUB_BITS, buckets = BUCKETS;
+        uint64_t fields[3] = {m_total, min(), m_max};
+        out.write("OBHIST01", 8);
+        out.write(reinterpret_cast<const char*>(&sub_bits), sizeof(sub_bits));
+        out.write(reinterpret_cast<const char*>(&buckets), sizeof(buckets));
+        out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        out.write(reinterpret_cast<const char*>(m_counts.data()), sizeof(uint64_t) * BUCKETS);
+        return static_cast<bool>(out);
+    }
+
+    // Корзина: до SUB_COUNT — само значение, дальше — сдвиг и старшие SUB_BITS бит
+    static size_t index_of(uint64_t value) {
+        if (value < SUB_COUNT) return static_cast<size_t>(value);
+        unsigned shift = std::bit_width(value) - SUB_BITS;
+        return shift * HALF + static_cast<size_t>(value >> shift);
+    }
+    static uint64_t lowest_in(size_t index) {
+        if (index < SUB_COUNT) return index;
+        unsigned shift = static_cast<unsigned>(index / HALF - 1);
+        return static_cast<uint64_t>(index - shift * HALF) << shift;
+    }
+    static uint64_t highest_in(size_t index) {
+        if (index < SUB_COUNT) return index;
+        unsigned shift = static_cast<unsigned>(index / HALF - 1);
+        return lowest_in(index) + ((uint64_t{1} << shift) - 1);
+    }
+
+private:
+    std::array<uint64_t, BUCKETS> m_counts{};
+    uint64_t m_total = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = std::numeric_limits<uint64_t>::max();
+    uint64_t m_max = 0;
+};
@@ -0,0 +1,38 @@
+/**
+ * @file market_data.hpp
+ * @brief Aggregated L2 depth records produced by the book for market data.
+ *
+ * DepthLevel is one row of a top-of-book snapshot (Orderbook::top_n).
+ * LevelUpdate is one row of an incremental change set
+ * (Orderbook::publish_depth): the new state of a level that changed since
+ * the previous publish, with quantity 0 meaning the level is gone.
+ * Quantities are visible size only; iceberg reserves are not disclosed.
+ * SweepEstimate (Orderbook::estimate_sweep) is the exception: it is what an
+ * aggressive order would actually get, reserves included.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "enums.hpp"
+
+struct DepthLevel {
+    int32_t price_cents = 0;
+    uint32_t orders = 0;   // ордеров на уровне
+    int64_t quantity = 0;  // видимый объём уровня
+};
+
+struct SweepEstimate {
+    int64_t quantity = 0;          // исполнилось бы, включая резервы айсбергов
+    int64_t notional = 0;          // в центах, точно
+    int32_t last_price_cents = 0;  // худшая задетая цена, 0 — ничего
+
+    double vwap_cents() const { return quantity ? static_cast<double>(notional) / quantity : 0.0; }
+};
+
+struct LevelUpdate {
+    BookSide side = BookSide::bid;
+    int32_t price_cents = 0;
+    uint32_t orders = 0;
+    int64_t quantity = 0;  // 0 — уровень удалён
+};
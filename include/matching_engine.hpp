@@ -0,0 +1,96 @@
+/**
+ * @file matching_engine.hpp
+ * @brief Single-writer matching thread that owns an Orderbook.
+ *
+ * Gateway threads never touch the book: they submit Commands through an
+ * inbound ring (SPSC for one dedicated gateway, MPSC for several), the
+ * matching thread applies them and publishes a Result per command on the
+ * outbound SPSC ring. The book itself needs no locks. Bursts from the
+ * dedicated gateway go through Orderbook::process_batch, i.e. in that
+ * gateway's seq order; the shared ring is applied in arrival order.
+ *
+ * The outbound ring applies back-pressure: the result consumer has to keep
+ * polling until stop() returns.
+ *
+ * With a Journal attached, every command is appended to it before it is
+ * applied, in application order (an out-of-order burst is sorted by seq
+ * first). A command that no longer fits is not applied and is answered
+ * with ok = false. With a checkpoint interval the journal also gets a
+ * CommandType::checkpoint record carrying the book's digest once that many
+ * commands have gone by (checked after each burst), so a replica following
+ * the journal detects divergence close to where it happens (see replica.hpp).
+ *
+ * Idle passes compact levels holding tombstones, a few at a time, when the
+ * book uses CancelPolicy::tombstone and no journal is attached. With a
+ * journal, slots come back only through commands (a level reaching
+ * compact_percent, tombstones popped by the matcher), so a replay assigns
+ * the same IDs.
+ *
+ * Warm the book up (book().warm_up) and the journal (Journal::warm_up)
+ * before start(); with -DORDERBOOK_ALLOC_GUARD the matching thread of a
+ * warmed book then aborts on any heap allocation (alloc_guard.hpp).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "command.hpp"
+#include "journal.hpp"
+#include "mpsc_ring.hpp"
+#include "orderbook.hpp"
+#include "spsc_ring.hpp"
+
+class MatchingEngine {
+public:
+    explicit MatchingEngine(size_t ring_capacity = 1 << 16);
+    // Книга с заданной конфигурацией (например, CancelPolicy::tombstone)
+    explicit MatchingEngine(const BookConfig& config, size_t ring_capacity = 1 << 16);
+    ~MatchingEngine();
+
+    MatchingEngine(const MatchingEngine&) = delete;
+    MatchingEngine& operator=(const MatchingEngine&) = delete;
+
+    // Starts the matching thread, pinned to `cpu` when cpu >= 0
+    void start(int cpu = -1);
+    // Drains the inbound rings and joins the matching thread
+    void stop();
+
+    // Single dedicated gateway thread (SPSC). Returns false if the ring is full.
+    bool submit(const Command& cmd) { return m_inbound.try_push(cmd); }
+    // Any number of gateway threads (MPSC). Returns false if the ring is full.
+    bool submit_shared(const Command& cmd) { return m_shared_inbound.try_push(cmd); }
+
+    // One consumer thread reads results in the order commands were applied
+    bool poll(Result& out) { return m_outbound.try_pop(out); }
+
+    // Доступ к книге — только пока поток сопоставления не запущен
+    Orderbook& book() { return m_book; }
+    // Журнал команд (nullptr — без журнала); тоже только до start().
+    // checkpoint_interval > 0 — запись digest() после пачки, на которой набралось столько команд
+    // Конфигурация книги записывается в заголовок журнала (Journal::record_book_config)
+    void set_journal(Journal* journal, size_t checkpoint_interval = 0) {
+        if (journal) journal->record_book_config(m_book.config());
+        m_journal = journal;
+        m_checkpoint_interval = checkpoint_interval;
+        m_since_checkpoint = 0;
+    }
+
+private:
+    void run(int cpu);
+    bool drain_once();
+    void publish(const Result& result);
+    bool journal(const Command& cmd) { return !m_journal || m_journal->append(cmd); }
+    void maybe_checkpoint(size_t applied);
+
+    Orderbook m_book{false};
+    SpscRing<Command> m_inbound;
+    MpscRing<Command> m_shared_inbound;
+    SpscRing<Result> m_outbound;
+    Journal* m_journal = nullptr;
+    size_t m_checkpoint_interval = 0;
+    size_t m_since_checkpoint = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> m_running{false};
+    std::thread m_thread;
+};
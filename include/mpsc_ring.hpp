@@ -0,0 +1,77 @@
+/**
+ * @file mpsc_ring.hpp
+ * @brief Bounded lock-free multi-producer/single-consumer ring.
+ *
+ * Per-cell sequence numbers (Vyukov's bounded queue): producers claim a slot
+ * with a CAS on the tail, publish it by bumping the cell's sequence, and the
+ * single consumer reads cells in order without any read-modify-write.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "helpers.hpp"
+
+template <typename T>
+class MpscRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit MpscRing(size_t capacity)
+        : m_mask(std::bit_ceil(capacity < 2 ? size_t{2} : capacity) - 1),
+          m_cells(std::make_unique<Cell[]>(m_mask + 1)) {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Any thread
+    bool try_push(const T& value) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // полон: потребитель ещё не освободил ячейку
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool try_pop(T& out) {
+        Cell& cell = m_cells[m_head & m_mask];
+        if (cell.seq.load(std::memory_order_acquire) != m_head + 1) return false;
+        out = cell.value;
+        cell.seq.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail{0}; // общий для производителей
+    alignas(CACHE_LINE_SIZE) size_t m_head = 0;             // только потребитель
+    alignas(CACHE_LINE_SIZE) const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+};
@@ -12,18 +12,27 @@
 #include "enums.hpp"
 #include "helpers.hpp"
 
-inline uint64_t generate_unique_id() {
-    static uint64_t s_next_id{0};
-    return ++s_next_id;
-}
+// "Нет ордера" для интрузивных ссылок prev/next (индексы в OrderPool)
+static constexpr uint32_t NIL_INDEX = UINT32_MAX;
 
+// С -DORDERBOOK_SOA горячие поля сопоставления (quantity, next) хранятся
+// не здесь, а в плотных массивах OrderPool — см. OrderPool::quantity/next
 struct Order {
     uint64_t id;
     int32_t price_cents;
+#ifndef ORDERBOOK_SOA
     int quantity;
+#endif
+    uint32_t prev = NIL_INDEX; // предыдущий ордер на уровне (индекс в пуле)
+#ifndef ORDERBOOK_SOA
+    uint32_t next = NIL_INDEX; // следующий ордер на уровне (индекс в пуле)
+#endif
+    uint32_t generation = 1;   // старшие 32 бита ID, растёт при каждом освобождении слота
+    int display = 0;           // айсберг: размер видимой части, 0 — обычный ордер
+    int reserve = 0;           // айсберг: скрытый остаток
+    uint32_t owner = 0;        // сессия-владелец, 0 — без владельца (не в списках)
+    uint32_t owner_prev = NIL_INDEX; // соседи в списке стоящих ордеров владельца
+    uint32_t owner_next = NIL_INDEX;
+    BookSide side = BookSide::bid;
     bool active = false; // помечает, используется ли слот
-
-    Order() = default;
-    Order(uint64_t id_, int qty, int32_t price, bool active_ = true)
-        : id(id_), price_cents(price), quantity(qty), active(active_) {}
 };
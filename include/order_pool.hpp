@@ -1,57 +1,422 @@
 // include/order_pool.hpp
 #pragma once
 #include "order.hpp"
-#include <vector>
-#include <stack>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <iostream>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
 
-class OrderPool {
+// ID ордера = (generation << 32) | slot. Поиск по ID — проверка границ и
+// индекс в массиве; generation отсекает устаревшие ID после переиспользования слота.
+inline uint64_t make_order_id(uint32_t slot, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | slot;
+}
+inline uint32_t order_id_slot(uint64_t id) { return static_cast<uint32_t>(id); }
+
+#ifdef ORDERBOOK_SOA
+inline constexpr const char* ORDER_LAYOUT = "soa";
+#else
+inline constexpr const char* ORDER_LAYOUT = "aos";
+#endif
+
+// Слоты живут в чанках: первый на initial_capacity (округлённую до степени
+// двойки), каждый следующий удваивает ёмкость. Каталог чанков фиксирован,
+// поэтому адрес слота не меняется при росте, а индекс -> чанк — это один clz.
+//
+// Свободные слоты связаны в стек через их собственное поле next, без
+// отдельной памяти. Concurrent = true — стек Трайбера с тегом в старших
+// 32 битах головы (защита от ABA): acquire/release можно звать из любых
+// потоков, рост чанком идёт под мьютексом. Concurrent = false — обычный
+// индекс головы для единственного владельца (поток сопоставления).
+template <bool Concurrent>
+class BasicOrderPool {
 public:
-    // ИСПРАВЛЕНИЕ: Убрали free_indices_(capacity) из списка инициализации
-    explicit OrderPool(size_t capacity) : orders_(capacity) {
-        // std::stack будет увеличиваться по мере вызова push
-        for (size_t i = 0; i < capacity; ++i) {
-            free_indices_.push(i);
+    static constexpr size_t MAX_CHUNKS = 32;
+    static constexpr size_t MAX_SLOTS = NIL_INDEX; // NIL_INDEX сам не выдаётся
+
+    // max_capacity == 0: растём, пока хватает индексов
+    explicit BasicOrderPool(size_t initial_capacity,
+                            std::pmr::memory_resource* mr = std::pmr::get_default_resource(),
+                            size_t max_capacity = 0)
+        : m_mr(mr),
+          m_chunk_shift(std::countr_zero(std::bit_ceil(std::max<size_t>(initial_capacity, 64)))),
+          m_max_capacity(max_capacity ? std::min(max_capacity, MAX_SLOTS) : MAX_SLOTS) {
+        grow_locked(); // весь первый чанк — заранее
+    }
+
+    ~BasicOrderPool() {
+        for (size_t k = 0; k < m_chunk_count; ++k) {
+            size_t n = chunk_slots(k);
+            std::pmr::polymorphic_allocator<Order>(m_mr).deallocate(m_chunks[k].orders, n);
+#ifdef ORDERBOOK_SOA
+            std::pmr::polymorphic_allocator<int>(m_mr).deallocate(m_chunks[k].quantities, n);
+            std::pmr::polymorphic_allocator<uint32_t>(m_mr).deallocate(m_chunks[k].next, n);
+#endif
+        }
+    }
+
+    BasicOrderPool(const BasicOrderPool&) = delete;
+    BasicOrderPool& operator=(const BasicOrderPool&) = delete;
+
+    // nullptr только если пул упёрся в max_capacity
+    Order* acquire(int qty, int32_t price_cents, BookSide side) {
+        uint32_t idx = pop();
+        if (idx == NIL_INDEX) return nullptr;
+        Order& order = (*this)[idx];
+        order.price_cents = price_cents;
+        order.side = side;
+        order.owner = 0;
+        quantity(idx) = qty;
+        activate(idx);
+        note_acquired(1);
+        return &order;
+    }
+
+    // До n слотов одним снятием со стека; поля, кроме id, заполняет вызывающий.
+    // Возвращает, сколько выдано (меньше n — только на max_capacity).
+    size_t acquire_n(Order** out, size_t n) {
+        size_t got = 0;
+        while (got < n) {
+            uint32_t first = NIL_INDEX;
+            size_t taken = pop_chain(n - got, first);
+            if (taken == 0) break;
+            for (uint32_t idx = first; taken-- > 0; ) {
+                uint32_t link = load_next(idx);
+                activate(idx);
+                out[got++] = &(*this)[idx];
+                idx = link;
+            }
         }
-        next_id_.store(1);
+        note_acquired(got);
+        return got;
     }
 
-    Order* acquire(int qty, int32_t price_cents) {
-        if (free_indices_.empty()) return nullptr;
-        size_t idx = free_indices_.top();
-        free_indices_.pop();
-        uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
-        orders_[idx].id = id;
-        orders_[idx].price_cents = price_cents;
-        orders_[idx].quantity = qty;
-        orders_[idx].active = true;
-        return &orders_[idx];
+    Order& operator[](uint32_t idx) { return chunk_of(idx).orders[chunk_offset(idx)]; }
+    const Order& operator[](uint32_t idx) const { return const_cast<BasicOrderPool*>(this)->operator[](idx); }
+
+    // Горячие поля по индексу слота: в AoS — поля Order, в SoA — плотные
+    // массивы, так что проход по уровню читает только их
+#ifdef ORDERBOOK_SOA
+    int& quantity(uint32_t idx) { return chunk_of(idx).quantities[chunk_offset(idx)]; }
+    int quantity(uint32_t idx) const { return const_cast<BasicOrderPool*>(this)->quantity(idx); }
+    uint32_t& next(uint32_t idx) { return chunk_of(idx).next[chunk_offset(idx)]; }
+    uint32_t next(uint32_t idx) const { return const_cast<BasicOrderPool*>(this)->next(idx); }
+#else
+    int& quantity(uint32_t idx) { return (*this)[idx].quantity; }
+    int quantity(uint32_t idx) const { return (*this)[idx].quantity; }
+    uint32_t& next(uint32_t idx) { return (*this)[idx].next; }
+    uint32_t next(uint32_t idx) const { return (*this)[idx].next; }
+#endif
+
+    // Подтянуть слот в кэш заранее (пакетная обработка)
+    void prefetch(uint32_t idx) {
+        if (idx >= capacity()) return;
+        __builtin_prefetch(&(*this)[idx], 1);
+#ifdef ORDERBOOK_SOA
+        __builtin_prefetch(&quantity(idx), 1);
+        __builtin_prefetch(&next(idx), 1);
+#endif
+    }
+
+    // Слот зашит в младшие биты ID
+    uint32_t index_of(const Order* order) const { return order_id_slot(order->id); }
+
+    // Живой ордер по ID или nullptr (чужой слот, освобождённый или переиспользованный)
+    Order* find(uint64_t id) {
+        uint32_t slot = order_id_slot(id);
+        if (slot >= capacity()) return nullptr;
+        Order& order = (*this)[slot];
+        return (order.active && order.id == id) ? &order : nullptr;
     }
 
     void release(Order* order) {
         if (!order || !order->active) return;
+        uint32_t idx = checked_index(order);
+        retire(order);
+        push_chain(idx, idx, 1);
+    }
+
+    // Ленивая отмена в два шага: bury гасит ордер сразу (find его больше не
+    // находит), а слот остаётся занятым, пока его не вернут через reclaim —
+    // когда ордер снят с уровня
+    void bury(Order* order) {
+        if (!order || !order->active) return;
+        checked_index(order);
+        retire(order);
+    }
+    void reclaim(uint32_t idx) { push_chain(idx, idx, 1); }
+
+    // Возвращает целую очередь уровня first..last (по next) одной операцией:
+    // живые ордера гасятся, надгробия уже погашены
+    void release_chain(uint32_t first, uint32_t last, size_t count) {
+        for (uint32_t i = first;; i = load_next(i)) {
+            Order& order = (*this)[i];
+            if (order.active) retire(&order);
+            if (i == last) break;
+        }
+        push_chain(first, last, count);
+    }
+
+    // Возвращает n ордеров одним CAS: сначала связываем их между собой
+    void release_n(Order* const* orders, size_t n) {
+        uint32_t first = NIL_INDEX, last = NIL_INDEX;
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            Order* order = orders[i];
+            if (!order || !order->active) continue;
+            uint32_t idx = checked_index(order);
+            retire(order);
+            if (first == NIL_INDEX) first = idx;
+            else store_next(last, idx);
+            last = idx;
+            ++count;
+        }
+        if (count) push_chain(first, last, count);
+    }
+
+    // Для отладки и подбора размеров пула по символам
+    size_t capacity() const { return m_capacity.load(std::memory_order_acquire); }
+    size_t max_capacity() const { return m_max_capacity; }
+    size_t in_use() const { return m_in_use.load(std::memory_order_relaxed); }
+    size_t high_water() const { return m_high_water.load(std::memory_order_relaxed); }
+    size_t available() const { return capacity() - in_use(); }
+    size_t chunk_count() const { return m_chunk_count; }
+
+    // Снимок пула (только однопоточный). Чанки покрывают индексы подряд, так что
+    // f(begin, orders, quantities, next, n) получает слоты [begin, begin + n)
+    // кусками в порядке индексов; quantities/next — nullptr в AoS
+    template <typename F>
+    void for_each_chunk(F&& f) requires (!Concurrent) {
+        size_t cap = capacity();
+        for (size_t k = 0; k < m_chunk_count; ++k) {
+            size_t begin = k ? size_t{1} << (m_chunk_shift + k - 1) : 0;
+            size_t n = std::min(chunk_slots(k), cap - begin);
+            Chunk& chunk = m_chunks[k];
+#ifdef ORDERBOOK_SOA
+            f(static_cast<uint32_t>(begin), chunk.orders, chunk.quantities, chunk.next, n);
+#else
+            f(static_cast<uint32_t>(begin), chunk.orders, static_cast<int*>(nullptr), static_cast<uint32_t*>(nullptr), n);
+#endif
+        }
+    }
+    uint32_t free_head() const requires (!Concurrent) { return static_cast<uint32_t>(m_head); }
+
+    // Растит пул до `slots` слотов; false, если упёрлись в max_capacity.
+    // Новые слоты ложатся под свободные: выдача идёт в том же порядке, что
+    // и при росте по требованию, так что ID не зависят от того, был ли reserve
+    bool reserve(size_t slots) requires (!Concurrent) {
+        while (capacity() < slots) {
+            if (!grow_locked(true)) return false;
+        }
+        return true;
+    }
+
+    // После записи слотов из снимка: голова свободного стека и счётчики
+    void restore(uint32_t head, size_t in_use, size_t high_water) requires (!Concurrent) {
+        m_head = head;
+        m_in_use.store(in_use, std::memory_order_relaxed);
+        m_high_water.store(high_water, std::memory_order_relaxed);
+    }
 
-        // Проверка: order лежит внутри [orders_.data(), orders_.data() + orders_.size())
-        Order* begin = orders_.data();
-        Order* end = begin + orders_.size();
-        if (order < begin || order >= end) {
+private:
+    struct Chunk {
+        Order* orders = nullptr;
+#ifdef ORDERBOOK_SOA
+        int* quantities = nullptr;
+        uint32_t* next = nullptr;
+#endif
+    };
+
+    // Голова стека: в Concurrent — (tag << 32) | index
+    using Head = std::conditional_t<Concurrent, std::atomic<uint64_t>, uint64_t>;
+
+    size_t chunk_slots(size_t k) const { return size_t{1} << (m_chunk_shift + (k ? k - 1 : 0)); }
+    size_t chunk_index(uint32_t idx) const { return std::bit_width(static_cast<size_t>(idx) >> m_chunk_shift); }
+    Chunk& chunk_of(uint32_t idx) { return m_chunks[chunk_index(idx)]; }
+    // Чанк k >= 1 начинается с 2^(shift + k - 1): смещение — индекс без старшего бита
+    size_t chunk_offset(uint32_t idx) const {
+        return chunk_index(idx) ? idx ^ (size_t{1} << (std::bit_width(idx) - 1)) : idx;
+    }
+
+    uint32_t load_next(uint32_t idx) {
+        if constexpr (Concurrent) return std::atomic_ref<uint32_t>(next(idx)).load(std::memory_order_relaxed);
+        else return next(idx);
+    }
+    void store_next(uint32_t idx, uint32_t link) {
+        if constexpr (Concurrent) std::atomic_ref<uint32_t>(next(idx)).store(link, std::memory_order_relaxed);
+        else next(idx) = link;
+    }
+
+    void activate(uint32_t idx) {
+        Order& order = (*this)[idx];
+        order.id = make_order_id(idx, order.generation);
+        order.prev = NIL_INDEX;
+        order.display = order.reserve = 0;
+        order.active = true;
+        store_next(idx, NIL_INDEX); // устаревший pop в Concurrent ещё может читать ссылку
+    }
+
+    void retire(Order* order) {
+        order->active = false;
+        if (++order->generation == 0) order->generation = 1; // ID 0 не выдаём
+    }
+
+    uint32_t checked_index(Order* order) {
+        uint32_t idx = order_id_slot(order->id);
+        if (idx >= capacity() || &(*this)[idx] != order) {
             // Это не наш ордер! Кто-то использовал new/delete напрямую.
             // Лучше упасть явно, чем повредить память.
             std::cerr << "FATAL: release() called with foreign pointer: " << order << "\n";
-            std::cerr << "Pool range: [" << begin << ", " << end << ")\n";  
             std::abort();
         }
+        return idx;
+    }
 
-        order->active = false;
-        size_t idx = order - begin;
-        free_indices_.push(idx);
+    void note_acquired(size_t n) {
+        if (n == 0) return;
+        if constexpr (Concurrent) {
+            size_t now = m_in_use.fetch_add(n, std::memory_order_relaxed) + n;
+            size_t seen = m_high_water.load(std::memory_order_relaxed);
+            while (now > seen && !m_high_water.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {}
+        } else {
+            size_t now = m_in_use.load(std::memory_order_relaxed) + n;
+            m_in_use.store(now, std::memory_order_relaxed);
+            if (now > m_high_water.load(std::memory_order_relaxed)) m_high_water.store(now, std::memory_order_relaxed);
+        }
     }
 
-    // Для отладки
-    size_t available() const { return free_indices_.size(); }
+    uint32_t pop() {
+        uint32_t idx = NIL_INDEX;
+        return pop_chain(1, idx) ? idx : NIL_INDEX;
+    }
 
-private:
-    std::vector<Order> orders_;
-    std::stack<size_t> free_indices_;
-    std::atomic<uint64_t> next_id_{1};
-};
\ No newline at end of file
+    // Снимает до n верхних слотов; first — первый из них, дальше по next
+    size_t pop_chain(size_t n, uint32_t& first) {
+        for (;;) {
+            if constexpr (Concurrent) {
+                uint64_t head = m_head.load(std::memory_order_acquire);
+                uint32_t top = static_cast<uint32_t>(head);
+                if (top == NIL_INDEX) {
+                    if (!grow()) return 0;
+                    continue;
+                }
+                // Ссылки могут устареть, если слот уже забрали, — тогда CAS не пройдёт
+                size_t taken = 1;
+                uint32_t link = load_next(top);
+                while (taken < n && link != NIL_INDEX) {
+                    link = load_next(link);
+                    ++taken;
+                }
+                uint64_t tagged = (((head >> 32) + 1) << 32) | link;
+                if (m_head.compare_exchange_weak(head, tagged, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    first = top;
+                    return taken;
+                }
+            } else {
+                uint32_t top = static_cast<uint32_t>(m_head);
+                if (top == NIL_INDEX) {
+                    if (!grow()) return 0;
+                    continue;
+                }
+                size_t taken = 1;
+                uint32_t link = next(top);
+                while (taken < n && link != NIL_INDEX) {
+                    link = next(link);
+                    ++taken;
+                }
+                m_head = link;
+                first = top;
+                return taken;
+            }
+        }
+    }
+
+    // Кладёт цепочку first..last (уже связанную через next) на вершину стека
+    void push_chain(uint32_t first, uint32_t last, size_t count) {
+        if constexpr (Concurrent) {
+            uint64_t head = m_head.load(std::memory_order_relaxed);
+            uint64_t tagged;
+            do {
+                store_next(last, static_cast<uint32_t>(head));
+                tagged = (((head >> 32) + 1) << 32) | first;
+            } while (!m_head.compare_exchange_weak(head, tagged, std::memory_order_release, std::memory_order_relaxed));
+            m_in_use.fetch_sub(count, std::memory_order_relaxed);
+        } else {
+            next(last) = static_cast<uint32_t>(m_head);
+            m_head = first;
+            m_in_use.store(m_in_use.load(std::memory_order_relaxed) - count, std::memory_order_relaxed);
+        }
+    }
+
+    bool grow() {
+        if constexpr (Concurrent) {
+            std::lock_guard<std::mutex> lock(m_grow_mutex);
+            // Пока ждали мьютекс, другой поток мог уже добавить чанк
+            if (static_cast<uint32_t>(m_head.load(std::memory_order_acquire)) != NIL_INDEX) return true;
+            return grow_locked();
+        } else {
+            return grow_locked();
+        }
+    }
+
+    // Добавляет чанк и кладёт его слоты на стек, младшие — сверху
+    // (below — под уже свободные слоты, только без Concurrent)
+    bool grow_locked(bool below = false) {
+        size_t k = m_chunk_count;
+        size_t start = capacity();
+        if (k == MAX_CHUNKS || start >= m_max_capacity) return false;
+        size_t n = std::min(chunk_slots(k), m_max_capacity - start);
+        size_t alloc = chunk_slots(k); // индексация чанка предполагает полный размер
+
+        Chunk chunk;
+        chunk.orders = std::pmr::polymorphic_allocator<Order>(m_mr).allocate(alloc);
+#ifdef ORDERBOOK_SOA
+        chunk.quantities = std::pmr::polymorphic_allocator<int>(m_mr).allocate(alloc);
+        chunk.next = std::pmr::polymorphic_allocator<uint32_t>(m_mr).allocate(alloc);
+#endif
+        m_chunks[k] = chunk;
+        for (size_t i = 0; i < alloc; ++i) {
+            uint32_t idx = static_cast<uint32_t>(start + i);
+            new (&chunk.orders[i]) Order{};
+            chunk.orders[i].id = make_order_id(idx, 1);
+#ifdef ORDERBOOK_SOA
+            chunk.quantities[i] = 0;
+#endif
+            next(idx) = (i + 1 < n) ? idx + 1 : NIL_INDEX;
+        }
+        m_chunk_count = k + 1;
+        m_capacity.store(start + n, std::memory_order_release);
+        if constexpr (!Concurrent) {
+            if (below && m_head != NIL_INDEX) {
+                uint32_t tail = static_cast<uint32_t>(m_head);
+                while (next(tail) != NIL_INDEX) tail = next(tail);
+                next(tail) = static_cast<uint32_t>(start);
+                return true;
+            }
+        }
+        push_chain(static_cast<uint32_t>(start), static_cast<uint32_t>(start + n - 1), 0);
+        return true;
+    }
+
+    std::pmr::memory_resource* m_mr;
+    size_t m_chunk_shift;
+    size_t m_max_capacity;
+
+    std::array<Chunk, MAX_CHUNKS> m_chunks{};
+    size_t m_chunk_count = 0;
+    std::atomic<size_t> m_capacity{0};
+
+    alignas(CACHE_LINE_SIZE) Head m_head{NIL_INDEX};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_in_use{0};
+    std::atomic<size_t> m_high_water{0};
+    std::mutex m_grow_mutex; // только рост в Concurrent
+};
+
+// Пул книги: один владелец — поток сопоставления
+using OrderPool = BasicOrderPool<false>;
+// Общий пул для гейтвеев, заранее набирающих ордера из нескольких потоков
+using SharedOrderPool = BasicOrderPool<true>;
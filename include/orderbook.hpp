@@ -4,161 +4,447 @@
  * 
  * The Orderbook class represents an order book, which is a collection of buy and sell orders.
  * It provides functionality to add orders, execute orders, and retrieve the best quote.
- * The order book is implemented using two maps, one for buy orders (bids) and one for sell orders (asks).
- * Each map is sorted based on the price of the orders.
- * The Orderbook class also provides methods to clean up empty keys and print the order book.
+ * Each side is a PriceLadder of levels indexed by tick, and orders live in a slot pool.
+ * Matching runs through one kernel specialized at compile time per taker side and order type.
+ * Levels touched since the last publish are tracked, so market data can go out as deltas.
+ * With -DORDERBOOK_STATS the hot path also keeps counters readable from another thread.
+ * The Orderbook class also provides methods to print the order book.
  */
 
 #pragma once
 
-#include <deque>
-#include <map>
-#include <unordered_map>
-#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <vector>
+#include "book_stats.hpp"
+#include "command.hpp"
 #include "enums.hpp"
+#include "events.hpp"
+#include "market_data.hpp"
 #include "order.hpp"
 #include "order_pool.hpp"
-#include <set>
+#include "price_bitmap.hpp"
+#include "price_ladder.hpp"
 
+// Ценовой диапазон книги по умолчанию (см. BookConfig)
 static const int MIN_PRICE_CENTS = 1;
 static const int MAX_PRICE_CENTS =  200000; // $2000.00 — достаточно для $1500
 static const int PRICE_RANGE = MAX_PRICE_CENTS - MIN_PRICE_CENTS + 1; // 100000
 
-struct PriceLevel {
-    std::vector<Order*> orders;
-    size_t head = 0;
+// How delete_order takes an order off its level
+enum class CancelPolicy : uint8_t {
+    unlink,    // сразу вынуть из очереди и вернуть слот в пул
+    tombstone  // погасить на месте за O(1); снимает сопоставление или уплотнение
+};
 
-    // Типы итераторов
-    using iterator = typename std::vector<Order*>::iterator;
-    using const_iterator = typename std::vector<Order*>::const_iterator;
+// Per-instrument sizing, fixed at construction
+struct BookConfig {
+    int32_t min_price_cents = MIN_PRICE_CENTS; // must lie on the tick grid
+    int32_t max_price_cents = MAX_PRICE_CENTS;
+    int32_t tick_size = 1;                     // шаг цены в центах
+    size_t pool_capacity = 1'000'000;          // слотов под ордера сразу, дальше пул растёт чанками
+    size_t max_pool_capacity = 0;              // предел роста пула, 0 — без предела
+    // 0 — уровни на весь диапазон. Иначе в памяти только окно из window_ticks
+    // тиков вокруг касания, остальные уровни — в разреженном overflow.
+    // Уровней в памяти не больше PriceBitmap::MAX_BITS (16M), иначе конструктор бросает
+    size_t window_ticks = 0;
+    // На сколько ордеров вперёд проход по уровню подтягивает слоты пула;
+    // 0 — без программной предвыборки (и без поиска следующего уровня заранее)
+    size_t prefetch_distance = 1;
+    CancelPolicy cancel_policy = CancelPolicy::unlink;
+    // tombstone: уровень уплотняется, когда надгробия составляют столько
+    // процентов его очереди (и всегда, когда живых ордеров не осталось)
+    uint32_t compact_percent = 50;
 
-    // Начало "живых" ордеров
-    iterator begin() {
-        return orders.begin() + head;
+    size_t level_count() const {
+        return static_cast<size_t>((max_price_cents - min_price_cents) / tick_size) + 1;
     }
 
-    const_iterator begin() const {
-        return orders.begin() + head;
+    // Upper bound on what a book draws from its memory resource before the
+    // pool first grows: the first pool chunk plus both sides' levels and bitmaps
+    size_t arena_bytes() const {
+        size_t levels = (window_ticks && window_ticks < level_count()) ? std::bit_ceil(window_ticks) : level_count();
+        return std::bit_ceil(std::max<size_t>(pool_capacity, 64)) * 64 + levels * 64 + (size_t{1} << 16);
     }
+};
 
-    // Конец всех ордеров (включая "мертвые")
-    iterator end() {
-        return orders.end();
-    }
+// What Orderbook::warm_up prepares the book for before the open
+struct WarmupProfile {
+    int32_t reference_price_cents = 0; // ожидаемая середина на открытии; 0 — середина диапазона книги
+    size_t levels_per_side = 512;      // тиков по каждую сторону от неё, где ждём глубину
+    size_t expected_orders = 0;        // пик стоящих ордеров: столько слотов пула сразу
+    uint32_t expected_owners = 0;      // наибольший номер сессии (cancel_all(owner))
+    size_t max_batch = 256;            // наибольший пакет process_batch не по порядку
+};
 
-    const_iterator end() const {
-        return orders.end();
+class Orderbook {
+private:
+    // std::map<double, std::deque<std::unique_ptr<Order>>, std::greater<double>> m_bids;
+    // std::map<double, std::deque<std::unique_ptr<Order>>, std::less<double>> m_asks;
+    // std::vector<std::deque<std::unique_ptr<Order>>> m_bids;
+    // std::vector<std::deque<std::unique_ptr<Order>>> m_asks;
+
+    BookConfig m_config;
+
+    // Уровни по тику (price_cents - min_price_cents) / tick_size
+    PriceLadder m_bids;
+    PriceLadder m_asks;
+
+    // Пул ордеров
+    OrderPool m_order_pool;
+
+    // Цена на сетке шага и внутри диапазона книги
+    bool in_band(int32_t price_cents) const {
+        if (price_cents < m_config.min_price_cents || price_cents > m_config.max_price_cents) return false;
+        return m_config.tick_size == 1 || (price_cents - m_config.min_price_cents) % m_config.tick_size == 0;
+    }
+    size_t price_index(int32_t price_cents) const {
+        int32_t offset = price_cents - m_config.min_price_cents;
+        return static_cast<size_t>(m_config.tick_size == 1 ? offset : offset / m_config.tick_size);
+    }
+    int32_t index_price(size_t idx) const {
+        return m_config.min_price_cents + static_cast<int32_t>(idx) * m_config.tick_size;
     }
+    Order* acquire_order(int qty, int32_t price_cents, BookSide side, uint32_t owner = 0);
+    template <typename Sink>
+    void rest_order(Order* order, Sink& sink);
+    // Ядро сопоставления тейкера стороны S против противоположной стороны.
+    // Для T == market limit_price не читается
+    template <Side S, OrderType T, typename Sink>
+    void match(int& order_quantity, int32_t limit_price, uint64_t taker_id,
+               int& units_transacted, int64_t& total_value, Sink& sink);
+    // Что снял бы тейкер стороны S до cap (и лимита для T == limit) — без
+    // изменений книги. Подряд идущие уровни окна суммирует scan_levels
+    template <Side S, OrderType T>
+    SweepEstimate sweep(int64_t cap, int32_t limit_price) const;
+    // FOK: хватит ли видимого и скрытого объёма в пределах лимита
+    template <Side S, OrderType T>
+    bool can_fill(int order_quantity, int32_t limit_price) const {
+        return sweep<S, T>(order_quantity, limit_price).quantity >= order_quantity;
+    }
+    // В режиме окна двигает окно стороны за касанием
+    void maybe_recenter(BookSide side);
+    // Уровень и слот пула, которые понадобятся команде
+    void prefetch_command(const Command& cmd);
 
-    // Удаление по итератору
-    iterator erase(iterator pos) {
-        if (pos < begin()) {
-            // Это "мертвый" ордер — не удаляем
-            return pos;
+    // Курсор предвыборки в очереди уровня: prefetch_distance ордеров впереди головы
+    uint32_t prefetch_ahead(uint32_t head) {
+        uint32_t ahead = head;
+        for (size_t k = 0; k < m_config.prefetch_distance && ahead != NIL_INDEX; ++k) {
+            ahead = m_order_pool.next(ahead);
+            if (ahead != NIL_INDEX) m_order_pool.prefetch(ahead);
         }
-        return orders.erase(pos);
+        return ahead;
+    }
+    // Голова ушла — курсор на шаг вперёд; его строка уже подтянута
+    uint32_t prefetch_step(uint32_t ahead) {
+        if (ahead == NIL_INDEX) return ahead;
+        ahead = m_order_pool.next(ahead);
+        if (ahead != NIL_INDEX) m_order_pool.prefetch(ahead);
+        return ahead;
     }
 
-    // Удаление по индексу (если нужно)
-    void erase(size_t index) {
-        if (index < head) return; // мёртвый
-        orders.erase(orders.begin() + index);
+    // Уровень изменился: тик попадает в следующую публикацию глубины (один раз)
+    void mark_dirty(BookSide side, size_t t, PriceLevel& level) {
+        if (level.dirty) return;
+        level.dirty = true;
+        (side == BookSide::bid ? m_dirty_bids : m_dirty_asks).push_back(t);
     }
+    void publish_side(BookSide side, std::vector<LevelUpdate>& out);
 
-    // Остальные методы (как раньше)
-    bool empty() const { return head >= orders.size(); }
-    // Неконстантная версия — для изменения
-    Order*& front() {
-        if (empty()) {
-            static Order* null_ptr = nullptr;
-            return null_ptr;
-        }
-        return orders[head];
+    // Вклад уровня в digest(): смесь стороны, тика, объёма, резерва и числа
+    // живых ордеров. У уровня без живых ордеров — 0, пустые уровни не в счёт
+    static uint64_t level_hash(BookSide side, size_t t, const PriceLevel& level) {
+        if (level.count == 0) return 0;
+        uint64_t h = ((static_cast<uint64_t>(t) << 1) | static_cast<uint64_t>(side)) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint64_t>(level.quantity) * 0xC2B2AE3D27D4EB4Full;
+        h ^= static_cast<uint64_t>(level.reserve) * 0x165667B19E3779F9ull;
+        h ^= static_cast<uint64_t>(level.count) * 0xD6E8FEB86659FD93ull;
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ull;
+        return h ^ (h >> 32);
     }
+    // Вызывается до и после изменения уровня: XOR снимает старый вклад и вносит новый
+    void fold_level(BookSide side, size_t t, const PriceLevel& level) { m_digest ^= level_hash(side, t, level); }
+    uint64_t full_digest() const;
 
-    // Константная версия — для чтения
-    const Order* front() const {
-        if (empty()) return nullptr;
-        return orders[head];
+    // Уровень с надгробиями — в очередь compact() (один раз)
+    void queue_compaction(BookSide side, size_t t, PriceLevel& level) {
+        if (level.compact_queued) return;
+        level.compact_queued = true;
+        (side == BookSide::bid ? m_compact_bids : m_compact_asks).push_back(t);
     }
-    void pop_front() { if (!empty()) head++; }
-    void push_back(Order* order) { orders.push_back(order); }
-    size_t size() const { return orders.size() - head; }
+    bool needs_compaction(const PriceLevel& level) const {
+        return level.count == 0 || level.tombstones == UINT16_MAX ||
+               uint64_t{level.tombstones} * 100 >= uint64_t{level.count + level.tombstones} * m_config.compact_percent;
+    }
+    // Снимает все надгробия уровня, возвращает их число
+    size_t compact_level(PriceLevel& level);
+    size_t compact_side(BookSide side, size_t& budget);
 
-    // Опционально: compact()
-    void compact() {
-        if (head == 0) return;
-        if (head >= orders.size()) {
-            orders.clear();
-            head = 0;
-            return;
-        }
-        std::move(orders.begin() + head, orders.end(), orders.begin());
-        orders.resize(orders.size() - head);
-        head = 0;
+    // Стоящие ордера владельца по сторонам: интрузивный список по owner_prev/owner_next
+    struct OwnerOrders {
+        uint32_t head[2] = {NIL_INDEX, NIL_INDEX};
+    };
+    void link_owner(uint32_t slot) {
+        Order& order = m_order_pool[slot];
+        if (!order.owner) return;
+        if (order.owner >= m_owners.size()) m_owners.resize(size_t{order.owner} + 1);
+        uint32_t& head = m_owners[order.owner].head[static_cast<int>(order.side)];
+        order.owner_prev = NIL_INDEX;
+        order.owner_next = head;
+        if (head != NIL_INDEX) m_order_pool[head].owner_prev = slot;
+        head = slot;
     }
+    void unlink_owner(uint32_t slot) {
+        Order& order = m_order_pool[slot];
+        if (!order.owner) return;
+        if (order.owner_prev != NIL_INDEX) m_order_pool[order.owner_prev].owner_next = order.owner_next;
+        else m_owners[order.owner].head[static_cast<int>(order.side)] = order.owner_next;
+        if (order.owner_next != NIL_INDEX) m_order_pool[order.owner_next].owner_prev = order.owner_prev;
+        order.owner_prev = order.owner_next = NIL_INDEX;
+    }
+    template <typename Sink>
+    size_t cancel_owner_side(uint32_t owner, BookSide side, Sink& sink);
 
-    // Неконстантный доступ
-Order*& operator[](size_t index) {
-    return orders[head + index];
-}
+    std::vector<uint32_t> m_batch_order; // порядок по seq для неупорядоченных пакетов
+    // Тики, изменённые с последнего publish_depth (возможны повторы — снимаются при публикации)
+    std::vector<size_t> m_dirty_bids;
+    std::vector<size_t> m_dirty_asks;
+    // Тики уровней, где могут быть надгробия (CancelPolicy::tombstone)
+    std::vector<size_t> m_compact_bids;
+    std::vector<size_t> m_compact_asks;
+    // По номеру владельца; номера сессий выдаются подряд, так что таблица плотная
+    std::vector<OwnerOrders> m_owners;
 
-// Константный доступ
-const Order* operator[](size_t index) const {
-    return orders[head + index];
-}
-};
+    uint64_t m_digest = 0; // XOR level_hash по всем уровням, см. digest()
+    bool m_warmed = false;
 
+    [[no_unique_address]] BookCounters m_stats;
+public:
+    Orderbook(bool generate_dummies);
+    // Level arrays, bitmaps and the pool are allocated from `mr`
+    explicit Orderbook(const BookConfig& config,
+                       std::pmr::memory_resource* mr = std::pmr::get_default_resource());
 
-class Orderbook {
-private:
-    // std::map<double, std::deque<std::unique_ptr<Order>>, std::greater<double>> m_bids;
-    // std::map<double, std::deque<std::unique_ptr<Order>>, std::less<double>> m_asks;
-    // std::vector<std::deque<std::unique_ptr<Order>>> m_bids;
-    // std::vector<std::deque<std::unique_ptr<Order>>> m_asks;
+    const BookConfig& config() const { return m_config; }
+    void set_prefetch_distance(size_t distance) { m_config.prefetch_distance = distance; }
 
-    std::vector<PriceLevel> m_bids;
-    std::vector<PriceLevel> m_asks;
+    // Call before the open so the first orders run at steady-state speed:
+    // centers windowed ladders on the reference price, touches the level
+    // headers around it, grows the pool to expected_orders slots (its chunks
+    // are written, so their pages are faulted in) and reserves the dirty,
+    // compaction, batch and owner tables. State, IDs and digest stay as they
+    // are, so a warmed primary and an unwarmed replica remain identical.
+    // After it, operations within the profile do not touch the heap (check
+    // with AllocationGuard); only overflow levels outside a window still do.
+    // Returns false if max_pool_capacity is below expected_orders.
+    bool warm_up(const WarmupProfile& profile);
+    bool warmed_up() const { return m_warmed; }
 
-    // orderbook.hpp
-    std::set<int> m_active_asks;
-    std::set<int> m_active_bids;
-    
-        // Кэш: order_id → (side, price_cents)
-    std::unordered_map<uint64_t, std::pair<BookSide, int32_t>> m_order_metadata;
+    // The Sink overloads report every fill, rest, cancel and modify as an
+    // ExecEvent; the plain overloads use NullSink. Sinks are instantiated in
+    // orderbook.cpp (NullSink, EventRing).
 
-    // Пул ордеров
-    OrderPool m_order_pool{1'000'000}; // на миллион ордеров
-public:
-    Orderbook(bool generate_dummies);
+    // Returns the new order's ID, or 0 for qty <= 0 or a price outside the band or off the tick grid
+    // `owner` (> 0) files the order under that session for cancel_all(owner)
+    uint64_t add_order(int qty, int32_t price, BookSide side, uint32_t owner = 0) {
+        NullSink sink;
+        return add_order(qty, price, side, owner, sink);
+    }
+    template <typename Sink>
+    uint64_t add_order(int qty, int32_t price, BookSide side, Sink& sink) {
+        return add_order(qty, price, side, 0, sink);
+    }
+    template <typename Sink>
+    uint64_t add_order(int qty, int32_t price, BookSide side, uint32_t owner, Sink& sink);
 
-    void add_order(int qty, int32_t price, BookSide side);
-    std::pair<int, double> handle_order(OrderType type, int order_quantity, Side side, int32_t price = 0);
+    // Returns (units transacted, notional in cents). IOC/FOK never rest;
+    // a FOK shortfall or a crossing post-only order is reported as a reject
+    // and leaves the book untouched. display_qty > 0 rests a GTC limit as an
+    // iceberg that shows at most display_qty at a time.
+    std::pair<int, int64_t> handle_order(OrderType type, int order_quantity, Side side, int32_t price = 0,
+                                         TimeInForce tif = TimeInForce::gtc, int display_qty = 0,
+                                         uint32_t owner = 0) {
+        NullSink sink;
+        return handle_order(type, order_quantity, side, price, tif, display_qty, owner, sink);
+    }
+    template <typename Sink>
+    std::pair<int, int64_t> handle_order(OrderType type, int order_quantity, Side side, int32_t price, Sink& sink) {
+        return handle_order(type, order_quantity, side, price, TimeInForce::gtc, 0, sink);
+    }
+    template <typename Sink>
+    std::pair<int, int64_t> handle_order(OrderType type, int order_quantity, Side side, int32_t price,
+                                         TimeInForce tif, int display_qty, Sink& sink) {
+        return handle_order(type, order_quantity, side, price, tif, display_qty, 0, sink);
+    }
+    template <typename Sink>
+    std::pair<int, int64_t> handle_order(OrderType type, int order_quantity, Side side, int32_t price,
+                                         TimeInForce tif, int display_qty, uint32_t owner, Sink& sink);
 
-    bool modify_order(uint64_t id, int new_qty);
-    bool delete_order(uint64_t id);
+    // Sets the size (visible + reserve) in place, keeping queue priority; an
+    // iceberg keeps its displayed slice, clipped to new_qty, and the rest goes
+    // to reserve. Returns false for an unknown ID or new_qty <= 0.
+    bool modify_order(uint64_t id, int new_qty) {
+        NullSink sink;
+        return modify_order(id, new_qty, sink);
+    }
+    template <typename Sink>
+    bool modify_order(uint64_t id, int new_qty, Sink& sink);
 
-    template <typename T>
-    std::pair<int, double> fill_order(std::map<double, std::deque<std::unique_ptr<Order>>, T>& offers,
-                                      const OrderType type, const Side side, int& order_quantity,
-                                      int32_t price, int& units_transacted, double& total_value);
+    // Amends size (visible + reserve) and price. A pure size-down at the same
+    // price keeps queue priority; a size-up or a new price sends the same
+    // pool slot to the back of its new level, matching first if the new price
+    // crosses. Returns false for an unknown ID, new_qty <= 0 or a price off
+    // the book; units/value receive what the crossing part executed.
+    bool replace_order(uint64_t id, int new_qty, int32_t new_price) {
+        NullSink sink;
+        int units = 0;
+        int64_t value = 0;
+        return replace_order(id, new_qty, new_price, units, value, sink);
+    }
+    template <typename Sink>
+    bool replace_order(uint64_t id, int new_qty, int32_t new_price, int& units_transacted, int64_t& total_value,
+                       Sink& sink);
+
+    // Under CancelPolicy::tombstone the order disappears at once (find, depth,
+    // matching), but its slot is reclaimed only when the matcher pops it or
+    // its level is compacted: at compact_percent, when the level has no live
+    // orders left, or through compact().
+    bool delete_order(uint64_t id) {
+        NullSink sink;
+        return delete_order(id, sink);
+    }
+    template <typename Sink>
+    bool delete_order(uint64_t id, Sink& sink);
+
+    // Mass cancel: every order resting on `side` goes, one pool operation per
+    // level (tombstones included). Returns the number of live orders cancelled.
+    size_t cancel_all(BookSide side) {
+        NullSink sink;
+        return cancel_all(side, sink);
+    }
+    template <typename Sink>
+    size_t cancel_all(BookSide side, Sink& sink);
+
+    // Session drop: cancels only `owner`'s resting orders (one side or both),
+    // walking its own list; emptied levels leave the bitmap once and the
+    // slots go back to the pool in one operation. Returns the number cancelled.
+    size_t cancel_all(uint32_t owner) {
+        NullSink sink;
+        return cancel_all(owner, sink);
+    }
+    size_t cancel_all(uint32_t owner, BookSide side) {
+        NullSink sink;
+        return cancel_all(owner, side, sink);
+    }
+    template <typename Sink>
+    size_t cancel_all(uint32_t owner, Sink& sink) {
+        return cancel_owner_side(owner, BookSide::bid, sink) + cancel_owner_side(owner, BookSide::ask, sink);
+    }
+    template <typename Sink>
+    size_t cancel_all(uint32_t owner, BookSide side, Sink& sink) { return cancel_owner_side(owner, side, sink); }
+
+    // Is `id` a live order filed under `owner`? Gateways check it before acting for a session
+    bool owned_by(uint64_t id, uint32_t owner) {
+        const Order* order = m_order_pool.find(id);
+        return order && order->owner == owner;
+    }
+
+    // Applies one command (order/modify/cancel) and reports its outcome
+    Result execute(const Command& cmd);
+
+    // Applies a batch in seq order with the same semantics as execute();
+    // results[i] answers commands[i]. Returns the number of commands applied,
+    // min(commands.size(), results.size()).
+    size_t process_batch(std::span<const Command> commands, std::span<Result> results);
+    // Same, but strictly in the given order whatever the seqs: a journal or a
+    // replication stream is already in the order the primary applied it
+    size_t apply_in_order(std::span<const Command> commands, std::span<Result> results);
+
+    // Order-independent hash of every level's side, price, visible quantity,
+    // reserve and live order count, kept up to date on each change (O(1) to
+    // read). Two books fed the same command stream have equal digests, so a
+    // replica compares it against the primary's to detect divergence.
+    uint64_t digest() const { return m_digest; }
 
     int best_quote(BookSide side);
 
-    const auto& get_bids() { return m_bids; }
-    const auto& get_asks() { return m_asks; }
+    // What a market order (or a limit order at limit_price) for qty from the
+    // taker `side` would fill right now, reserves included; the book is not
+    // touched. Pass INT64_MAX to get everything available up to the limit.
+    SweepEstimate estimate_sweep(Side side, int64_t qty) const;
+    SweepEstimate estimate_sweep(Side side, int64_t qty, int32_t limit_price) const;
+
+    // Compacts up to max_levels levels holding tombstones and returns the
+    // number of slots reclaimed; meant for idle cycles of the matching thread.
+    // Not a command: a book that is journaled for replay must not call it
+    size_t compact(size_t max_levels = SIZE_MAX);
+
+    // Best n levels of a side, best price first, walking occupied levels only.
+    // Writes min(n, out.size(), levels) rows and returns how many
+    size_t top_n(BookSide side, size_t n, std::span<DepthLevel> out) const;
+
+    // Replaces `out` with the levels changed since the previous call (bids,
+    // then asks, each in ascending price), with their current aggregates;
+    // a level that emptied is reported with quantity 0. Returns out.size().
+    size_t publish_depth(std::vector<LevelUpdate>& out);
+
+    // Point-in-time image of the pool, level FIFOs and window layout in an
+    // index-only format (no pointers), written section by section. Restore
+    // maps the file and copies each section into place. It expects a book
+    // built with the same BookConfig that has not grown past the snapshot,
+    // and throws std::runtime_error otherwise. `journal_position` is opaque
+    // to the book (e.g. Journal::size() when the snapshot was taken) and is
+    // returned by load_snapshot, so replay can resume from the journal tail.
+    // After a load every occupied level is reported by the next publish_depth.
+    void save_snapshot(const std::string& path, uint64_t journal_position = 0);
+    uint64_t load_snapshot(const std::string& path);
 
-    template<typename T>
-    void print_leg(std::map<double, std::deque<std::unique_ptr<Order>>, T>& orders, BookSide side);
+    // Counters for a monitoring thread; safe to call while another thread
+    // matches (see book_stats.hpp). Only the pool fields without ORDERBOOK_STATS.
+    BookStats stats() const {
+        BookStats s;
+        s.orders_added = m_stats.get(BookCounters::orders_added);
+        s.orders_filled = m_stats.get(BookCounters::orders_filled);
+        s.orders_cancelled = m_stats.get(BookCounters::orders_cancelled);
+        s.rejects = m_stats.get(BookCounters::rejects);
+        s.aggressive_orders = m_stats.get(BookCounters::aggressive_orders);
+        s.levels_swept = m_stats.get(BookCounters::levels_swept);
+        s.max_levels_swept = m_stats.get(BookCounters::max_levels_swept);
+        s.max_fifo_depth = m_stats.get(BookCounters::max_fifo_depth);
+        s.pool_in_use = m_order_pool.in_use();
+        s.pool_high_water = m_order_pool.high_water();
+        return s;
+    }
+
+    // Window storage; in the default (fixed) mode indexed by tick
+    const auto& get_bids() { return m_bids.storage(); }
+    const auto& get_asks() { return m_asks.storage(); }
+    const PriceLadder& bid_ladder() const { return m_bids; }
+    const PriceLadder& ask_ladder() const { return m_asks; }
+
+    // n-й ордер в очереди уровня (0 — первый на исполнение), nullptr если его нет
+    const Order* order_at(BookSide side, int32_t price_cents, size_t n) const;
+    // Видимый остаток ордера; в SoA-раскладке он лежит в пуле, а не в Order
+    int quantity_of(const Order& order) const { return m_order_pool.quantity(m_order_pool.index_of(&order)); }
+
+    // Обход всех ордеров стороны: уровни от лучшей цены к худшей, внутри — FIFO
+    template <typename F>
+    void for_each_order(BookSide side, F&& f) const {
+        const PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+        size_t t = (side == BookSide::bid) ? ladder.last() : ladder.first();
+        while (t != PriceLadder::npos) {
+            for (uint32_t i = ladder.find(t)->head; i != NIL_INDEX; i = m_order_pool.next(i)) {
+                if (m_order_pool[i].active) f(m_order_pool[i]); // надгробия пропускаем
+            }
+            if (side == BookSide::bid) t = t ? ladder.prev(t - 1) : PriceLadder::npos;
+            else t = ladder.next(t + 1);
+        }
+    }
 
     void print();
     void print_asks();
     void print_bids();
-    // Правильно — без Orderbook::
-    std::pair<int, double> fill_bids(int& order_quantity, int limit_price_cents, int& units_transacted, double& total_value);
-    std::pair<int, double> fill_asks(int& order_quantity, int limit_price_cents, int& units_transacted, double& total_value);
-
-    int m_best_bid = 0;
-    int m_best_ask = MAX_PRICE_CENTS + 1;
-
 };
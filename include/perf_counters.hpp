@@ -0,0 +1,44 @@
+/**
+ * @file perf_counters.hpp
+ * @brief Hardware counters for the calling thread through perf_event_open.
+ *
+ * Opens one counter group (cycles, instructions, LLC misses, dTLB load
+ * misses), user space only, so it works with perf_event_paranoid <= 2.
+ * Counters the PMU or the VM does not expose are skipped; if even cycles
+ * cannot be opened (containers, seccomp, paranoid 3) the group is
+ * unavailable and callers fall back to wall-clock time alone.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+class PerfCounters {
+public:
+    enum Event { cycles, instructions, cache_misses, dtlb_misses, EVENT_COUNT };
+    static constexpr const char* NAMES[EVENT_COUNT] = {"cycles", "instructions", "LLC-misses", "dTLB-misses"};
+
+    struct Reading {
+        std::array<uint64_t, EVENT_COUNT> value{};
+        std::array<bool, EVENT_COUNT> valid{};
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return m_fds[cycles] >= 0; }
+    bool has(Event e) const { return m_fds[e] >= 0; }
+
+    // Обнуляет и запускает всю группу / останавливает её
+    void start();
+    void stop();
+    // Значения с последнего start(); масштабируются при мультиплексировании
+    Reading read() const;
+
+private:
+    std::array<int, EVENT_COUNT> m_fds;
+};
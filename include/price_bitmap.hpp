@@ -0,0 +1,115 @@
+/**
+ * @file price_bitmap.hpp
+ * @brief Hierarchical occupancy bitmap over the price-indexed level array.
+ *
+ * Level 0 has one bit per price index, every higher level has one bit per
+ * 64-bit word of the level below ("this word is non-zero"). Finding the next
+ * occupied level above/below a price is a handful of ctz/clz instructions per
+ * level and never allocates after construction. Word storage comes from the
+ * given memory resource, so a book's bitmaps can live in a shared arena.
+ */
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+class PriceBitmap {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t MAX_DEPTH = 4; // 64^4 = 16M индексов
+    // Больше сводка не покрывает: empty()/first() смотрят только в верхнее слово
+    static constexpr size_t MAX_BITS = size_t{1} << (6 * MAX_DEPTH);
+
+    explicit PriceBitmap(size_t bits, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : m_bits(bits), m_words{Words(mr), Words(mr), Words(mr), Words(mr)} {
+        size_t n = bits;
+        do {
+            n = (n + 63) / 64;
+            m_words[m_depth++].assign(n, 0);
+        } while (n > 1 && m_depth < MAX_DEPTH);
+    }
+
+    size_t size() const { return m_bits; }
+    bool empty() const { return m_words[m_depth - 1][0] == 0; }
+
+    bool test(size_t i) const {
+        return (m_words[0][i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(size_t i) {
+        for (size_t l = 0; l < m_depth; ++l) {
+            uint64_t& word = m_words[l][i >> 6];
+            bool was_empty = word == 0;
+            word |= uint64_t{1} << (i & 63);
+            if (!was_empty) return; // верхние уровни уже помечены
+            i >>= 6;
+        }
+    }
+
+    void clear(size_t i) {
+        for (size_t l = 0; l < m_depth; ++l) {
+            uint64_t& word = m_words[l][i >> 6];
+            word &= ~(uint64_t{1} << (i & 63));
+            if (word != 0) return; // слово ещё не пустое — сводка не меняется
+            i >>= 6;
+        }
+    }
+
+    // Lowest set index >= i, or npos
+    size_t find_next(size_t i) const {
+        if (i >= m_bits) return npos;
+        size_t l = 0;
+        for (;;) {
+            size_t w = i >> 6;
+            uint64_t mask = m_words[l][w] & (~uint64_t{0} << (i & 63));
+            if (mask) {
+                i = (w << 6) + std::countr_zero(mask);
+                break;
+            }
+            if (++l == m_depth) return npos;
+            i = w + 1;
+            if ((i >> 6) >= m_words[l].size()) return npos;
+        }
+        // Спускаемся вниз, каждый раз беря младший бит
+        while (l-- > 0) {
+            i = (i << 6) + std::countr_zero(m_words[l][i]);
+        }
+        return i;
+    }
+
+    // Highest set index <= i, or npos
+    size_t find_prev(size_t i) const {
+        if (i == npos) return npos;
+        if (i >= m_bits) i = m_bits - 1;
+        size_t l = 0;
+        for (;;) {
+            size_t w = i >> 6;
+            uint64_t mask = m_words[l][w] & (~uint64_t{0} >> (63 - (i & 63)));
+            if (mask) {
+                i = (w << 6) + 63 - std::countl_zero(mask);
+                break;
+            }
+            if (++l == m_depth || w == 0) return npos;
+            i = w - 1;
+        }
+        while (l-- > 0) {
+            i = (i << 6) + 63 - std::countl_zero(m_words[l][i]);
+        }
+        return i;
+    }
+
+    size_t find_first() const { return find_next(0); }
+    size_t find_last() const { return m_bits ? find_prev(m_bits - 1) : npos; }
+
+private:
+    using Words = std::pmr::vector<uint64_t>;
+
+    size_t m_bits;
+    size_t m_depth = 0;
+    std::array<Words, MAX_DEPTH> m_words;
+};
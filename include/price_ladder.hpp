@@ -0,0 +1,276 @@
+/**
+ * @file price_ladder.hpp
+ * @brief One side's price levels indexed by tick, with an optional sliding window.
+ *
+ * In fixed mode the ladder is a plain array over the whole price band. In
+ * window mode only `window` ticks are allocated, in a power-of-two ring
+ * addressed by tick & mask, and the window can be recentered as the market
+ * moves. Levels outside the window spill to a sparse overflow map, so every
+ * in-band price is still accepted; only the hot window has to fit in cache.
+ *
+ * Levels are plain headers over intrusive order lists, so moving a level
+ * between the ring and the overflow map is O(1) regardless of its depth.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <vector>
+#include "order_pool.hpp"
+#include "price_bitmap.hpp"
+
+// FIFO-очередь уровня цены: интрузивный двусвязный список по индексам пула.
+// Постановка в хвост и снятие любого ордера — O(1), без сдвигов и аллокаций.
+// Заголовок — 32 байта, выровнен: два соседних тика в одной кэш-линии и ни
+// один не пересекает её границу. Объём и число ордеров ведутся инкрементально.
+// При ленивой отмене (CancelPolicy::tombstone) снятый ордер остаётся в очереди
+// с нулевым объёмом, пока его не снимет сопоставление или уплотнение.
+struct alignas(32) PriceLevel {
+    uint32_t head = NIL_INDEX;
+    uint32_t tail = NIL_INDEX;
+    int64_t quantity = 0;   // суммарный видимый объём уровня
+    int64_t reserve = 0;    // скрытые остатки айсбергов (видимая часть — в quantity)
+    uint32_t count = 0;     // число живых ордеров в очереди
+    uint16_t tombstones = 0; // снятые, но ещё стоящие в очереди
+    bool dirty = false;     // изменён с последней публикации глубины
+    bool compact_queued = false; // уже в очереди Orderbook::compact
+
+    bool empty() const { return head == NIL_INDEX; }
+
+    void push_back(OrderPool& pool, uint32_t idx) {
+        pool[idx].prev = tail;
+        pool.next(idx) = NIL_INDEX;
+        if (tail != NIL_INDEX) pool.next(tail) = idx;
+        else head = idx;
+        tail = idx;
+        quantity += pool.quantity(idx);
+        ++count;
+    }
+
+    void unlink(OrderPool& pool, uint32_t idx) {
+        detach(pool, idx);
+        quantity -= pool.quantity(idx);
+        --count;
+    }
+
+    // Очередь целиком отдана в пул (cancel_all); флаги публикации остаются
+    void clear() {
+        head = tail = NIL_INDEX;
+        quantity = reserve = 0;
+        count = 0;
+        tombstones = 0;
+    }
+
+    // Ленивая отмена: объём уходит с уровня сразу, ордер остаётся в очереди
+    void bury(OrderPool& pool, uint32_t idx) {
+        quantity -= pool.quantity(idx);
+        pool.quantity(idx) = 0;
+        --count;
+        ++tombstones;
+    }
+    void drop_tombstone(OrderPool& pool, uint32_t idx) {
+        detach(pool, idx);
+        --tombstones;
+    }
+
+    // Только ссылки списка, без счётчиков
+    void detach(OrderPool& pool, uint32_t idx) {
+        uint32_t prev = pool[idx].prev;
+        uint32_t next = pool.next(idx);
+        if (prev != NIL_INDEX) pool.next(prev) = next;
+        else head = next;
+        if (next != NIL_INDEX) pool[next].prev = prev;
+        else tail = prev;
+        pool[idx].prev = pool.next(idx) = NIL_INDEX;
+    }
+};
+static_assert(sizeof(PriceLevel) == 32, "PriceLevel header should stay 32 bytes");
+
+class PriceLadder {
+public:
+    static constexpr size_t npos = PriceBitmap::npos;
+
+    // Levels held in the array (and bits in the bitmap); a book refuses more than PriceBitmap::MAX_BITS
+    static size_t width(size_t level_count, size_t window) {
+        return (window == 0 || std::bit_ceil(window) >= level_count) ? level_count : std::bit_ceil(window);
+    }
+
+    // window == 0 or window >= level_count: fixed ladder over all levels
+    PriceLadder(size_t level_count, size_t window,
+                std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : m_level_count(level_count),
+          m_fixed(window == 0 || std::bit_ceil(window) >= level_count),
+          m_width(width(level_count, window)),
+          m_mask(m_width - 1),
+          m_levels(m_width, mr),
+          m_active(m_width, mr) {}
+
+    bool windowed() const { return !m_fixed; }
+    size_t window_lo() const { return m_lo; }
+    size_t window_width() const { return m_width; }
+    size_t overflow_levels() const { return m_overflow.size(); }
+    bool in_window(size_t t) const { return t - m_lo < m_width; }
+
+    // Хранилище окна (в фиксированном режиме индекс совпадает с тиком)
+    const std::pmr::vector<PriceLevel>& storage() const { return m_levels; }
+    PriceLevel* window_data() { return m_levels.data(); }
+
+    template <typename F>
+    void for_each_overflow(F&& f) const {
+        for (const auto& [t, lvl] : m_overflow) f(t, lvl);
+    }
+
+    // Снимок: окно с началом в lo уже записано в window_data(); занятость
+    // пересобирается по уровням, overflow очищается (заполняется через level())
+    void restore(size_t lo) {
+        m_lo = m_fixed ? 0 : lo;
+        m_overflow.clear();
+        for (size_t s = 0; s < m_width; ++s) {
+            if (m_levels[s].empty()) m_active.clear(s);
+            else m_active.set(s);
+        }
+    }
+
+    // Уровень тика, создаётся в overflow при необходимости
+    PriceLevel& level(size_t t) {
+        if (in_window(t)) return m_levels[slot(t)];
+        return m_overflow[t];
+    }
+
+    // nullptr, если вне окна и такого уровня нет
+    PriceLevel* find(size_t t) {
+        if (in_window(t)) return &m_levels[slot(t)];
+        auto it = m_overflow.find(t);
+        return it == m_overflow.end() ? nullptr : &it->second;
+    }
+    const PriceLevel* find(size_t t) const { return const_cast<PriceLadder*>(this)->find(t); }
+
+    // Уровни подряд в памяти окна от t в сторону роста тиков (descending —
+    // убывания): first — уровень t, результат — их число; 0, если t вне окна
+    size_t contiguous(size_t t, bool descending, const PriceLevel*& first) const {
+        if (!in_window(t)) return 0;
+        size_t s = slot(t);
+        first = &m_levels[s];
+        if (descending) return std::min(s, t - m_lo) + 1;
+        return std::min(m_width - s, m_lo + m_width - t);
+    }
+
+    // Заголовок уровня в окне — в кэш заранее; overflow не трогаем
+    void prefetch(size_t t) const {
+        if (in_window(t)) __builtin_prefetch(&m_levels[slot(t)], 1);
+    }
+
+    // Уровень t стал непустым
+    void mark_active(size_t t) {
+        if (in_window(t)) m_active.set(slot(t));
+    }
+
+    // Уровень t опустел: ссылка на него после вызова недействительна
+    void mark_empty(size_t t) {
+        if (in_window(t)) m_active.clear(slot(t));
+        else m_overflow.erase(t);
+    }
+
+    // Lowest occupied tick >= t, or npos
+    size_t next(size_t t) const {
+        size_t best = npos;
+        if (t < m_lo + m_width) best = window_next(std::max(t, m_lo));
+        auto it = m_overflow.lower_bound(t);
+        if (it != m_overflow.end() && it->first < best) best = it->first;
+        return best;
+    }
+
+    // Highest occupied tick <= t, or npos
+    size_t prev(size_t t) const {
+        if (t == npos) return npos;
+        size_t best = npos;
+        if (t >= m_lo) best = window_prev(std::min(t, m_lo + m_width - 1));
+        auto it = m_overflow.upper_bound(t);
+        if (it != m_overflow.begin()) {
+            --it;
+            if (best == npos || it->first > best) best = it->first;
+        }
+        return best;
+    }
+
+    size_t first() const { return next(0); }
+    size_t last() const { return m_level_count ? prev(m_level_count - 1) : npos; }
+
+    // Moves the window to start at `lo` (clamped to the band). Levels that
+    // leave the window go to overflow, overflow levels inside it move in.
+    void recenter(size_t lo) {
+        if (m_fixed) return;
+        lo = std::min(lo, m_level_count - m_width);
+        if (lo == m_lo) return;
+
+        size_t old_lo = m_lo;
+        size_t shift = lo > old_lo ? lo - old_lo : old_lo - lo;
+        size_t changed = std::min(shift, m_width);
+        m_lo = lo;
+
+        // Меняются только слоты тиков, покинувших окно; прочие остаются на месте
+        for (size_t i = 0; i < changed; ++i) {
+            size_t t_out = lo > old_lo ? old_lo + i : old_lo + m_width - 1 - i;
+            size_t s = slot(t_out);
+            PriceLevel& cell = m_levels[s];
+            if (!cell.empty()) {
+                m_overflow.emplace(t_out, cell);
+            }
+            size_t t_in = lo + ((s - lo) & m_mask); // тик нового окна в этом слоте
+            auto it = m_overflow.find(t_in);
+            if (it != m_overflow.end()) {
+                cell = it->second;
+                m_overflow.erase(it);
+                m_active.set(s);
+            } else {
+                cell = PriceLevel{};
+                m_active.clear(s);
+            }
+        }
+    }
+
+private:
+    size_t slot(size_t t) const { return m_fixed ? t : (t & m_mask); }
+    size_t tick_of(size_t s) const { return m_fixed ? s : m_lo + ((s - m_lo) & m_mask); }
+
+    // Поиск в кольце: логический порядок начинается со слота m_lo
+    size_t window_next(size_t t) const {
+        size_t p = slot(t);
+        size_t r = m_active.find_next(p);
+        if (m_fixed) return r;
+        size_t lo_s = slot(m_lo);
+        if (p >= lo_s) {
+            if (r != npos) return tick_of(r);
+            r = m_active.find_next(0);
+        }
+        return (r != npos && r < lo_s) ? tick_of(r) : npos;
+    }
+
+    size_t window_prev(size_t t) const {
+        size_t p = slot(t);
+        size_t r = m_active.find_prev(p);
+        if (m_fixed) return r;
+        size_t lo_s = slot(m_lo);
+        if (p >= lo_s) {
+            return (r != npos && r >= lo_s) ? tick_of(r) : npos;
+        }
+        if (r != npos) return tick_of(r);
+        r = m_active.find_prev(m_width - 1);
+        return (r != npos && r >= lo_s) ? tick_of(r) : npos;
+    }
+
+    size_t m_level_count;
+    bool m_fixed;
+    size_t m_width;
+    size_t m_mask;
+    size_t m_lo = 0; // первый тик окна
+
+    std::pmr::vector<PriceLevel> m_levels;
+    PriceBitmap m_active; // бит на слот окна
+    // Холодный путь: уровни вне окна живут в обычной куче
+    std::map<size_t, PriceLevel> m_overflow;
+};
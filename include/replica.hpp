@@ -0,0 +1,77 @@
+/**
+ * @file replica.hpp
+ * @brief Hot-standby copy of a primary book, fed the primary's sequenced command stream.
+ *
+ * The stream is the primary's journal: record i (from 0) carries sequence
+ * number i + 1 and is in the order the primary applied it (see
+ * MatchingEngine). Slots, and so order IDs, follow from the commands alone:
+ * a book built with the same BookConfig that applies the same records in
+ * the same order ends up identical, IDs included. That holds as long as the
+ * primary frees slots only through commands — a journaled MatchingEngine
+ * skips idle compaction, and nothing calls Orderbook::compact() on the side —
+ * and a restored snapshot keeps the owner lists in the primary's order.
+ *
+ * apply() takes records one at a time from any transport and accepts only
+ * the next sequence: an older one is a duplicate and is dropped, a newer one
+ * is a gap and is not applied; the caller fetches the missing records from
+ * the journal and passes them to catch_up(). CommandType::checkpoint records
+ * carry the primary's digest(); a mismatch marks the replica diverged, and
+ * it applies nothing more until restore().
+ *
+ * Catch-up never pauses the primary: a replica restores from a snapshot
+ * written by a standby (checkpoint()), then replays the journal tail, which
+ * the primary keeps appending to; follow() does both halves of the tailing
+ * loop for a journal on the same host.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include "command.hpp"
+#include "journal.hpp"
+#include "orderbook.hpp"
+
+class Replica {
+public:
+    enum class Status : uint8_t {
+        applied,   // применена (checkpoint — digest совпал)
+        duplicate, // уже применена — пропущена
+        gap,       // перед ней пропуск: нужны записи начиная с next_sequence()
+        diverged   // digest разошёлся с первичной книгой
+    };
+
+    explicit Replica(const BookConfig& config,
+                     std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : m_book(config, mr) {}
+
+    Status apply(uint64_t sequence, const Command& cmd);
+
+    // Applies the journal records from next_sequence() on (journal[0] is
+    // sequence 1), stopping at a checkpoint that does not match. Returns the
+    // number of records applied.
+    size_t catch_up(std::span<const Command> journal);
+    // Picks up what the primary appended to `reader`'s journal and applies it
+    size_t follow(JournalReader& reader) {
+        reader.refresh();
+        return catch_up(reader.records());
+    }
+
+    // Replaces the book with a snapshot written by checkpoint() (here or on
+    // another standby of the same BookConfig); clears a divergence
+    void restore(const std::string& snapshot_path);
+    // Snapshot of everything applied so far, tagged with its journal position
+    void checkpoint(const std::string& snapshot_path) { m_book.save_snapshot(snapshot_path, m_next - 1); }
+
+    uint64_t next_sequence() const { return m_next; }
+    // Sequence of the checkpoint that did not match, 0 while in sync
+    uint64_t diverged_at() const { return m_diverged_at; }
+    const Orderbook& book() const { return m_book; }
+
+private:
+    Orderbook m_book;
+    uint64_t m_next = 1;
+    uint64_t m_diverged_at = 0;
+};
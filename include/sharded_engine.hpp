@@ -0,0 +1,135 @@
+/**
+ * @file sharded_engine.hpp
+ * @brief Many books matched in parallel: symbols partitioned across pinned workers.
+ *
+ * Each worker thread owns a disjoint set of symbols and is the single writer
+ * of their books, exactly like MatchingEngine for one book. One router
+ * (gateway) thread submits commands tagged with a symbol; they travel through
+ * that symbol's worker's SPSC ring, and results come back per worker, merged
+ * by one consumer thread in poll().
+ *
+ * Books are created on their worker's thread after it is pinned, in a
+ * per-worker arena (BookManager), so with the kernel's first-touch policy the
+ * levels and pools land on that worker's NUMA node.
+ *
+ * A symbol is moved with move_symbol() (or rebalance(), which moves the
+ * hottest symbol of the busiest worker to the least loaded one). The old
+ * worker hands the book over when it reaches the move in its ring, i.e.
+ * after every command already routed to it; the new worker picks the book
+ * up before any command routed after the move. Moves may follow each other
+ * before the first one has happened (0→1→2, or back and forth): each adopt
+ * waits for the book of its own move. The book's memory stays on
+ * the node it was first touched on. Results of one symbol are in order per
+ * worker; across a move use Result::seq.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "book_manager.hpp"
+#include "command.hpp"
+#include "orderbook.hpp"
+#include "spsc_ring.hpp"
+
+struct ShardResult {
+    uint32_t symbol = 0;
+    Result result;
+};
+
+class ShardedEngine {
+public:
+    struct Options {
+        size_t workers = 1;
+        size_t ring_capacity = 1 << 16;  // на воркера, в каждую сторону
+        // CPU воркера i; по умолчанию CPU i, а дальше числа ядер — без привязки
+        std::vector<int> cpus;
+        size_t arena_bytes = 16 << 20;   // первый чанк арены воркера
+    };
+
+    explicit ShardedEngine(const Options& options);
+    ~ShardedEngine();
+
+    ShardedEngine(const ShardedEngine&) = delete;
+    ShardedEngine& operator=(const ShardedEngine&) = delete;
+
+    // Before start(): the book for `symbol` goes to `worker`, or -1 — the
+    // worker with the fewest symbols. Throws if the symbol already exists.
+    void add_symbol(uint32_t symbol, const BookConfig& config, int worker = -1);
+
+    // Starts the workers; returns once every book has been built
+    void start();
+    // Drains the rings and joins the workers; the consumer has to keep polling until then
+    void stop();
+
+    // Router thread only. False if the symbol has no book or its worker's ring is full.
+    bool submit(uint32_t symbol, const Command& cmd);
+    // One consumer thread; round-robin over the workers' result rings
+    bool poll(ShardResult& out);
+
+    // Router thread only: hand `symbol` to worker `to` at its quiesce point
+    bool move_symbol(uint32_t symbol, size_t to);
+    // Router thread only: by commands routed since the previous call, moves
+    // the busiest worker's hottest symbol to the least loaded worker if that
+    // lowers the maximum load. Returns true if a symbol moved.
+    bool rebalance();
+
+    size_t worker_count() const { return m_workers.size(); }
+    // -1 if the symbol is unknown; router thread (or while stopped)
+    int worker_of(uint32_t symbol) const {
+        return symbol < m_owner.size() ? m_owner[symbol] : -1;
+    }
+    // Книга символа — только пока воркеры не запущены или уже остановлены
+    Orderbook* book(uint32_t symbol);
+
+private:
+    struct Message {
+        enum class Kind : uint8_t { command, release, adopt };
+        Kind kind = Kind::command;
+        uint32_t symbol = 0;
+        uint64_t move = 0; // release/adopt: номер переезда символа
+        Command command;
+    };
+
+    // Книга в пути. Переезды одного символа нумеруются, и adopt ждёт книгу
+    // своего переезда: при цепочке 0→1→2 воркер 2 не заберёт книгу, которую
+    // воркер 0 ещё отдаёт воркеру 1. В пути не больше одной книги символа —
+    // следующий release делает тот же воркер, что принял предыдущую
+    struct alignas(CACHE_LINE_SIZE) Handoff {
+        Orderbook* book = nullptr;
+        std::atomic<uint64_t> move{0}; // публикует book
+    };
+
+    struct Worker {
+        Worker(size_t ring_capacity, int cpu) : inbound(ring_capacity), outbound(ring_capacity), cpu(cpu) {}
+
+        SpscRing<Message> inbound;
+        SpscRing<ShardResult> outbound;
+        int cpu;
+        std::vector<std::pair<uint32_t, BookConfig>> initial; // строятся в потоке воркера
+        std::unique_ptr<BookManager> manager;
+        std::vector<Orderbook*> books; // по символу; только поток воркера
+        std::thread thread;
+    };
+
+    void run(Worker& worker);
+    bool drain_once(Worker& worker);
+    void push(Worker& worker, const Message& message);
+
+    Options m_options;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    // Маршрутизация — только поток роутера
+    std::vector<int> m_owner;        // символ -> воркер, -1 — нет книги
+    std::vector<uint64_t> m_routed;  // команд на символ с прошлого rebalance()
+    std::vector<uint64_t> m_moves;   // переездов символа
+    size_t m_poll_next = 0;          // только поток потребителя
+
+    // Передача книги от старого воркера новому
+    std::unique_ptr<Handoff[]> m_handoff;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> m_running{false};
+    std::atomic<size_t> m_ready{0};
+};
@@ -0,0 +1,71 @@
+/**
+ * @file spsc_ring.hpp
+ * @brief Bounded lock-free single-producer/single-consumer ring.
+ *
+ * Head and tail live on separate cache lines, and each side keeps a cached
+ * copy of the other side's index so the shared line is only re-read when the
+ * ring looks full (producer) or empty (consumer).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include "helpers.hpp"
+
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+        : m_mask(std::bit_ceil(capacity < 2 ? size_t{2} : capacity) - 1),
+          m_buffer(std::make_unique<T[]>(m_mask + 1)) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side
+    bool try_push(const T& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head_cache > m_mask) {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail - m_head_cache > m_mask) return false; // полон
+        }
+        m_buffer[tail & m_mask] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool try_pop(T& out) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail_cache) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tail_cache) return false; // пуст
+        }
+        out = m_buffer[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Примерное значение: точно только для вызывающей стороны
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    // Поля потребителя
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head{0};
+    size_t m_tail_cache = 0;
+
+    // Поля производителя
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail{0};
+    size_t m_head_cache = 0;
+
+    // Неизменяемые после конструктора
+    alignas(CACHE_LINE_SIZE) const size_t m_mask;
+    std::unique_ptr<T[]> m_buffer;
+};
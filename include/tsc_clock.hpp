@@ -0,0 +1,58 @@
+/**
+ * @file tsc_clock.hpp
+ * @brief Cycle-counter timestamps with a tick rate calibrated at startup.
+ *
+ * tsc_now() is a fenced rdtsc on x86 (a few ns, no syscall); elsewhere it
+ * falls back to steady_clock nanoseconds. The tick rate is measured once,
+ * on first use, against steady_clock over a short spin, instead of assuming
+ * a nominal frequency. This relies on an invariant TSC (constant_tsc), which
+ * every x86 server CPU of the last decade has.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+inline uint64_t tsc_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence(); // не даём rdtsc уехать раньше измеряемого кода
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class TscClock {
+public:
+    // Наносекунд на тик; калибруется при первом вызове (~10 мс)
+    static double ns_per_tick() {
+        static const double value = calibrate();
+        return value;
+    }
+    static double ghz() { return 1.0 / ns_per_tick(); }
+
+    static uint64_t to_ns(uint64_t ticks) { return static_cast<uint64_t>(ticks * ns_per_tick()); }
+
+private:
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        uint64_t c0 = tsc_now();
+        while (clock::now() - t0 < std::chrono::milliseconds(10)) {}
+        uint64_t c1 = tsc_now();
+        auto t1 = clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        return c1 > c0 ? ns / (c1 - c0) : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+};
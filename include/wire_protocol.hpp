@@ -0,0 +1,361 @@
+/**
+ * @file wire_protocol.hpp
+ * @brief Fixed-layout little-endian order-entry messages and a zero-copy decoder.
+ *
+ * Every message starts with an 8-byte WireHeader and is a multiple of 8
+ * bytes long, so in a receive buffer aligned to 8 every message is aligned
+ * too. decode_messages() reinterprets the messages in place and hands the
+ * handler references into the buffer: no copies, no allocation, no parsing
+ * beyond range checks. Prices are integer cents, as everywhere in the book.
+ *
+ * The header carries a symbol so a router can pick the book or shard; the
+ * dispatchers below feed a single Orderbook, directly or through
+ * process_batch. Stream transports (TCP, byte rings in shared memory) use
+ * the consumed count to keep a trailing partial message, see WireStream.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "command.hpp"
+#include "orderbook.hpp"
+
+static_assert(std::endian::native == std::endian::little, "wire messages are little-endian");
+
+enum class WireType : uint8_t {
+    new_order = 1,
+    cancel = 2,
+    replace = 3,
+    mass_cancel = 4
+};
+
+// Сторона в заголовке: 0 — buy, 1 — sell; mass_cancel принимает и 2 — обе
+static const uint8_t WIRE_SIDE_BOTH = 2;
+
+struct WireHeader {
+    uint16_t length;  // длина всего сообщения в байтах, кратна 8
+    WireType type;
+    uint8_t side;
+    uint32_t symbol;
+};
+
+struct WireNewOrder {
+    WireHeader header;
+    uint64_t seq;
+    int32_t price_cents;      // для market не читается
+    int32_t quantity;
+    int32_t display_quantity; // > 0 — айсберг
+    uint8_t order_type;       // OrderType
+    uint8_t tif;              // TimeInForce
+    uint16_t reserved;
+};
+
+struct WireCancel {
+    WireHeader header;
+    uint64_t seq;
+    uint64_t order_id;
+};
+
+struct WireReplace {
+    WireHeader header;
+    uint64_t seq;
+    uint64_t order_id;
+    int32_t price_cents;
+    int32_t quantity;
+};
+
+struct WireMassCancel {
+    WireHeader header;
+    uint64_t seq;
+};
+
+static_assert(sizeof(WireHeader) == 8 && sizeof(WireNewOrder) == 32 && sizeof(WireCancel) == 24 &&
+              sizeof(WireReplace) == 32 && sizeof(WireMassCancel) == 16, "wire layout is fixed");
+static_assert(std::is_trivially_copyable_v<WireNewOrder> && std::is_trivially_copyable_v<WireReplace>);
+
+struct WireDecodeResult {
+    size_t messages = 0;   // отдано обработчику
+    size_t consumed = 0;   // байт с начала буфера; хвост — неполное сообщение
+    bool malformed = false; // длина или поля не сходятся — разбор остановлен на consumed
+};
+
+// Handler: on_new_order(const WireNewOrder&), on_cancel(const WireCancel&),
+// on_replace(const WireReplace&), on_mass_cancel(const WireMassCancel&).
+// Unknown types are skipped by their length. `buffer` must be 8-aligned.
+template <typename Handler>
+WireDecodeResult decode_messages(std::span<const std::byte> buffer, Handler& handler) {
+    assert(reinterpret_cast<uintptr_t>(buffer.data()) % alignof(uint64_t) == 0);
+    WireDecodeResult r;
+    const std::byte* p = buffer.data();
+    size_t left = buffer.size();
+    while (left >= sizeof(WireHeader)) {
+        const WireHeader& header = *reinterpret_cast<const WireHeader*>(p);
+        size_t length = header.length;
+        if (length < sizeof(WireHeader) || length % 8) {
+            r.malformed = true;
+            break;
+        }
+        if (length > left) break; // остаток придёт следующим чтением
+
+        bool valid = header.side <= 1;
+        switch (header.type) {
+        case WireType::new_order: {
+            const auto& msg = *reinterpret_cast<const WireNewOrder*>(p);
+            valid = valid && length >= sizeof(msg) && msg.order_type <= static_cast<uint8_t>(OrderType::limit) &&
+                    msg.tif <= static_cast<uint8_t>(TimeInForce::post_only) && msg.quantity > 0 &&
+                    msg.display_quantity >= 0;
+            if (valid) handler.on_new_order(msg);
+            break;
+        }
+        case WireType::cancel:
+            valid = valid && length >= sizeof(WireCancel);
+            if (valid) handler.on_cancel(*reinterpret_cast<const WireCancel*>(p));
+            break;
+        case WireType::replace:
+            valid = valid && length >= sizeof(WireReplace) &&
+                    reinterpret_cast<const WireReplace*>(p)->quantity > 0;
+            if (valid) handler.on_replace(*reinterpret_cast<const WireReplace*>(p));
+            break;
+        case WireType::mass_cancel:
+            valid = header.side <= WIRE_SIDE_BOTH && length >= sizeof(WireMassCancel);
+            if (valid) handler.on_mass_cancel(*reinterpret_cast<const WireMassCancel*>(p));
+            break;
+        default:
+            // Новый тип — пропускаем по длине
+            r.consumed += length;
+            p += length;
+            left -= length;
+            continue;
+        }
+        if (!valid) {
+            r.malformed = true;
+            break;
+        }
+        ++r.messages;
+        r.consumed += length;
+        p += length;
+        left -= length;
+    }
+    return r;
+}
+
+inline Side wire_side(uint8_t side) { return side ? Side::sell : Side::buy; }
+
+inline Command to_command(const WireNewOrder& m, uint32_t owner = 0) {
+    Command cmd;
+    cmd.seq = m.seq;
+    cmd.price_cents = m.price_cents;
+    cmd.quantity = m.quantity;
+    cmd.type = CommandType::order;
+    cmd.order_type = static_cast<OrderType>(m.order_type);
+    cmd.side = wire_side(m.header.side);
+    cmd.tif = static_cast<TimeInForce>(m.tif);
+    cmd.display_quantity = m.display_quantity;
+    cmd.owner = owner;
+    return cmd;
+}
+
+inline Command to_command(const WireCancel& m, uint32_t owner = 0) {
+    Command cmd;
+    cmd.seq = m.seq;
+    cmd.order_id = m.order_id;
+    cmd.type = CommandType::cancel;
+    cmd.side = wire_side(m.header.side);
+    cmd.owner = owner;
+    return cmd;
+}
+
+inline Command to_command(const WireReplace& m, uint32_t owner = 0) {
+    Command cmd;
+    cmd.seq = m.seq;
+    cmd.order_id = m.order_id;
+    cmd.price_cents = m.price_cents;
+    cmd.quantity = m.quantity;
+    cmd.type = CommandType::replace;
+    cmd.side = wire_side(m.header.side);
+    cmd.owner = owner;
+    return cmd;
+}
+
+// Encodes one command at `out` (8-aligned, room for 32 bytes); returns its
+// length, 0 for modify and checkpoint. For tests, benchmarks and clients; the book never encodes.
+inline size_t encode_message(const Command& cmd, uint32_t symbol, std::byte* out) {
+    uint8_t side = cmd.side == Side::sell ? 1 : 0;
+    switch (cmd.type) {
+    case CommandType::order: {
+        WireNewOrder m{{sizeof(m), WireType::new_order, side, symbol}, cmd.seq, cmd.price_cents, cmd.quantity,
+                       cmd.display_quantity, static_cast<uint8_t>(cmd.order_type), static_cast<uint8_t>(cmd.tif), 0};
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case CommandType::cancel: {
+        WireCancel m{{sizeof(m), WireType::cancel, side, symbol}, cmd.seq, cmd.order_id};
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case CommandType::modify: // своего сообщения нет: replace с прежней ценой
+    case CommandType::checkpoint: // только в журнале и потоке репликации
+        return 0;
+    case CommandType::replace: {
+        WireReplace m{{sizeof(m), WireType::replace, side, symbol}, cmd.seq, cmd.order_id, cmd.price_cents, cmd.quantity};
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    case CommandType::mass_cancel: {
+        WireMassCancel m{{sizeof(m), WireType::mass_cancel, cmd.both_sides ? WIRE_SIDE_BOTH : side, symbol}, cmd.seq};
+        std::memcpy(out, &m, sizeof(m));
+        return sizeof(m);
+    }
+    }
+    return 0;
+}
+
+// Applies each message to one book as it is decoded. With a session `owner`
+// (> 0) new orders are filed under it and mass cancel takes only its orders;
+// on disconnect the transport calls book.cancel_all(owner). Cancel and
+// replace act only on the session's own orders, another session's ID is
+// ignored. Without a session mass cancel is ignored: it would clear
+// everyone's orders.
+class WireBookDispatcher {
+public:
+    explicit WireBookDispatcher(Orderbook& book, uint32_t owner = 0) : m_book(book), m_owner(owner) {}
+
+    void on_new_order(const WireNewOrder& m) {
+        m_book.handle_order(static_cast<OrderType>(m.order_type), m.quantity, wire_side(m.header.side),
+                            m.price_cents, static_cast<TimeInForce>(m.tif), m.display_quantity, m_owner);
+    }
+    void on_cancel(const WireCancel& m) {
+        if (!m_owner || m_book.owned_by(m.order_id, m_owner)) m_book.delete_order(m.order_id);
+    }
+    void on_replace(const WireReplace& m) {
+        if (!m_owner || m_book.owned_by(m.order_id, m_owner)) m_book.replace_order(m.order_id, m.quantity, m.price_cents);
+    }
+    void on_mass_cancel(const WireMassCancel& m) {
+        if (!m_owner) return;
+        for (BookSide side : {BookSide::bid, BookSide::ask}) {
+            if (m.header.side != WIRE_SIDE_BOTH && m.header.side != static_cast<uint8_t>(side)) continue;
+            m_book.cancel_all(m_owner, side);
+        }
+    }
+
+private:
+    Orderbook& m_book;
+    uint32_t m_owner;
+};
+
+// Collects messages as Commands and applies them through process_batch, which
+// prefetches a few commands ahead; on_result(const Result&) gets every answer.
+// Call flush() after each decoded buffer. `owner` as in WireBookDispatcher;
+// a mass cancel without one, and a cancel or replace of another session's
+// order (execute() checks Command::owner), are answered with ok = false.
+template <typename OnResult>
+class WireBatchDispatcher {
+public:
+    WireBatchDispatcher(Orderbook& book, OnResult on_result, size_t batch = 64, uint32_t owner = 0)
+        : m_book(book), m_on_result(on_result), m_owner(owner), m_commands(batch), m_results(batch) {}
+
+    void on_new_order(const WireNewOrder& m) { push(to_command(m, m_owner)); }
+    void on_cancel(const WireCancel& m) { push(to_command(m, m_owner)); }
+    void on_replace(const WireReplace& m) { push(to_command(m, m_owner)); }
+    void on_mass_cancel(const WireMassCancel& m) {
+        if (!m_owner) {
+            // Ответ — после уже накопленных, в порядке прихода
+            flush();
+            Result rejected;
+            rejected.seq = m.seq;
+            m_on_result(rejected);
+            return;
+        }
+        Command cmd;
+        cmd.seq = m.seq;
+        cmd.type = CommandType::mass_cancel;
+        cmd.owner = m_owner;
+        // Одно сообщение — одна команда и один ответ, даже на обе стороны
+        cmd.both_sides = m.header.side == WIRE_SIDE_BOTH;
+        if (!cmd.both_sides) cmd.side = wire_side(m.header.side);
+        push(cmd);
+    }
+
+    void flush() {
+        size_t n = m_book.process_batch(std::span(m_commands.data(), m_pending), std::span(m_results.data(), m_pending));
+        for (size_t i = 0; i < n; ++i) m_on_result(m_results[i]);
+        m_pending = 0;
+    }
+
+private:
+    void push(const Command& cmd) {
+        m_commands[m_pending++] = cmd;
+        if (m_pending == m_commands.size()) flush();
+    }
+
+    Orderbook& m_book;
+    OnResult m_on_result;
+    uint32_t m_owner;
+    std::vector<Command> m_commands;
+    std::vector<Result> m_results;
+    size_t m_pending = 0;
+};
+
+// Reassembly buffer for stream transports: read() into writable(), commit()
+// what arrived, drain() decodes the complete messages and keeps the tail.
+// A message with bad fields but a sane length is skipped; a bad length loses
+// the message boundaries, so the stream closes (closed(), nothing more is
+// accepted) and the transport drops the connection. Both count as bad frames.
+class WireStream {
+public:
+    // Не меньше 64 КиБ: столько может занять одно сообщение (length — uint16)
+    explicit WireStream(size_t capacity = 1 << 16) : m_buffer((capacity + 7) / 8) {
+        if (capacity < (1 << 16)) throw std::invalid_argument("WireStream capacity must be at least 64 KiB");
+    }
+
+    std::span<std::byte> writable() {
+        if (m_closed) return {};
+        return {reinterpret_cast<std::byte*>(m_buffer.data()) + m_size, m_buffer.size() * 8 - m_size};
+    }
+    void commit(size_t n) { m_size += n; }
+
+    // consumed — байт, ушедших из буфера (пропущенные кадры тоже); malformed — были плохие кадры
+    template <typename Handler>
+    WireDecodeResult drain(Handler& handler) {
+        std::byte* data = reinterpret_cast<std::byte*>(m_buffer.data());
+        WireDecodeResult total;
+        while (!m_closed) {
+            std::span<const std::byte> pending(data + total.consumed, m_size - total.consumed);
+            WireDecodeResult r = decode_messages(pending, handler);
+            total.messages += r.messages;
+            total.consumed += r.consumed;
+            if (!r.malformed) break;
+            total.malformed = true;
+            ++m_bad_frames;
+            // Плохой кадр целиком в буфере (decode дошёл до проверки полей) — шагаем через него
+            size_t length = reinterpret_cast<const WireHeader*>(data + total.consumed)->length;
+            if (length < sizeof(WireHeader) || length % 8) {
+                m_closed = true;
+                total.consumed = m_size;
+                break;
+            }
+            total.consumed += length;
+        }
+        // Неполное сообщение — в начало буфера; оно короче одного сообщения
+        std::memmove(data, data + total.consumed, m_size - total.consumed);
+        m_size -= total.consumed;
+        return total;
+    }
+
+    bool closed() const { return m_closed; }
+    size_t bad_frames() const { return m_bad_frames; }
+
+private:
+    std::vector<uint64_t> m_buffer; // uint64_t — ради выравнивания на 8
+    size_t m_size = 0;
+    size_t m_bad_frames = 0;
+    bool m_closed = false;
+};
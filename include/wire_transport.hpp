@@ -0,0 +1,71 @@
+/**
+ * @file wire_transport.hpp
+ * @brief Non-blocking UDP receiver and the busy-poll loop that feeds the decoder.
+ *
+ * UdpReceiver pulls up to `batch` datagrams per system call (recvmmsg) into
+ * preallocated 8-aligned slots and hands each one to the caller in place;
+ * a datagram carries whole messages. Any other source plugs into run_feed()
+ * by providing poll(f) with the same contract: call f(std::span<const
+ * std::byte>) per received buffer, return how many there were. Stream
+ * sources (TCP, shared-memory byte rings) go through WireStream first.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <sys/socket.h>
+#include "helpers.hpp"
+#include "wire_protocol.hpp"
+
+class UdpReceiver {
+public:
+    // Binds to addr:port (port 0 — any free one, see port()); throws on failure
+    explicit UdpReceiver(uint16_t port, const char* addr = "0.0.0.0", size_t batch = 32, size_t datagram_bytes = 2048);
+    ~UdpReceiver();
+
+    UdpReceiver(const UdpReceiver&) = delete;
+    UdpReceiver& operator=(const UdpReceiver&) = delete;
+
+    uint16_t port() const { return m_port; }
+
+    // Receives what is queued, up to batch datagrams, without blocking
+    template <typename F>
+    size_t poll(F&& f) {
+        int n = receive();
+        for (int i = 0; i < n; ++i) {
+            f(std::span<const std::byte>(slot(i), m_headers[i].msg_len));
+        }
+        return n > 0 ? static_cast<size_t>(n) : 0;
+    }
+
+private:
+    int receive();
+    const std::byte* slot(size_t i) const {
+        return reinterpret_cast<const std::byte*>(m_storage.data()) + i * m_datagram_bytes;
+    }
+
+    int m_fd = -1;
+    uint16_t m_port = 0;
+    size_t m_datagram_bytes;
+    std::vector<uint64_t> m_storage; // batch слотов по datagram_bytes, выровнено на 8
+    std::vector<struct iovec> m_iov;
+    std::vector<struct mmsghdr> m_headers;
+};
+
+// Decodes everything `source` delivers into `handler` until `running` drops;
+// returns the number of messages decoded (malformed buffers are dropped)
+template <typename Source, typename Handler>
+size_t run_feed(Source& source, Handler& handler, const std::atomic<bool>& running) {
+    size_t messages = 0;
+    while (running.load(std::memory_order_relaxed)) {
+        size_t got = source.poll([&](std::span<const std::byte> buffer) {
+            messages += decode_messages(buffer, handler).messages;
+        });
+        if (!got) cpu_relax();
+    }
+    return messages;
+}
@@ -1,51 +1,68 @@
 #!/usr/bin/env python3
 
+import struct
+import sys
+
 import matplotlib.pyplot as plt
 
-def read_times(filename):
-    """Read one integer per line from a file and return a list of times in nanoseconds."""
-    times = []
-    with open(filename, 'r') as f:
-        for line in f:
-            line = line.strip()
-            if line:
-                times.append(int(line))
-    return times
+def read_histogram(filename):
+    """Read a LatencyHistogram dump (see include/latency_histogram.hpp).
+
+    Returns (bucket lower bounds in ns, counts), skipping empty buckets.
+    """
+    with open(filename, 'rb') as f:
+        magic = f.read(8)
+        if magic != b'OBHIST01':
+            raise ValueError(f"{filename}: not a histogram dump")
+        sub_bits, bucket_count = struct.unpack('<II', f.read(8))
+        total, lo, hi = struct.unpack('<QQQ', f.read(24))
+        counts = struct.unpack(f'<{bucket_count}Q', f.read(8 * bucket_count))
+
+    sub_count = 1 << sub_bits
+    half = sub_count // 2
+
+    def lowest(index):
+        if index < sub_count:
+            return index
+        shift = index // half - 1
+        return (index - shift * half) << shift
+
+    values = [lowest(i) for i, c in enumerate(counts) if c]
+    weights = [c for c in counts if c]
+    return values, weights
+
+def percentile(values, weights, q):
+    target = max(1, round(q * sum(weights)))
+    seen = 0
+    for v, w in zip(values, weights):
+        seen += w
+        if seen >= target:
+            return v
+    return values[-1] if values else 0
 
 def main():
-    # Read the data from the text files (times in nanoseconds)
-    market_times_ns = read_times("market_times.txt")
-    modify_times_ns = read_times("modify_times.txt")
-    delete_times_ns = read_times("delete_times.txt")
-    
-    # Convert nanoseconds to microseconds
-    market_times = [t / 1000.0 for t in market_times_ns]
-    modify_times = [t / 1000.0 for t in modify_times_ns]
-    delete_times = [t / 1000.0 for t in delete_times_ns]
-    
-    # Create a figure with 3 subplots in a row
-    fig, axs = plt.subplots(1, 3, figsize=(18, 5))
-    
-    bins = 100 # number of histogram bins
-    
-    # Plot market orders histogram
-    axs[0].hist(market_times, bins=bins, color='blue', alpha=0.7)
-    axs[0].set_title("Market Orders (μs)")
-    axs[0].set_xlabel("Time (μs)")
-    axs[0].set_ylabel("Frequency")
-    
-    # Plot modify orders histogram
-    axs[1].hist(modify_times, bins=bins, color='green', alpha=0.7)
-    axs[1].set_title("Modify Orders (μs)")
-    axs[1].set_xlabel("Time (μs)")
-    axs[1].set_ylabel("Frequency")
-    
-    # Plot delete orders histogram
-    axs[2].hist(delete_times, bins=bins, color='red', alpha=0.7)
-    axs[2].set_title("Delete Orders (μs)")
-    axs[2].set_xlabel("Time (μs)")
-    axs[2].set_ylabel("Frequency")
-    
+    # Dumps written by ./benchmark_orderbook (or ./replay_bench --dump)
+    files = sys.argv[1:] or ["market_hist.bin", "modify_hist.bin", "delete_hist.bin", "limit_hist.bin"]
+    colors = ['blue', 'green', 'red', 'purple']
+
+    fig, axs = plt.subplots(1, len(files), figsize=(6 * len(files), 5), squeeze=False)
+
+    for i, filename in enumerate(files):
+        values, weights = read_histogram(filename)
+        ax = axs[0][i]
+        # Buckets are log-linear: plot on a log axis with log-spaced bins
+        times = [max(v, 1) / 1000.0 for v in values]
+        lo, hi = min(times), max(times) * 1.01
+        bins = [lo * (hi / lo) ** (k / 100) for k in range(101)]
+        ax.hist(times, weights=weights, bins=bins, color=colors[i % len(colors)], alpha=0.7)
+        ax.set_xscale('log')
+        name = filename.replace('_hist.bin', '').replace('_', ' ')
+        p50 = percentile(values, weights, 0.50) / 1000.0
+        p99 = percentile(values, weights, 0.99) / 1000.0
+        ax.set_title(f"{name} (μs) — p50 {p50:.3f}, p99 {p99:.3f}")
+        ax.set_xlabel("Time (μs)")
+        ax.set_ylabel("Frequency")
+
     # Adjust layout to prevent overlapping elements
     plt.tight_layout()
     plt.show()
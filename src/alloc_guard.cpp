@@ -0,0 +1,78 @@
+/**
+ * @file alloc_guard.cpp
+ * @brief This file contains the AllocationGuard class and, with -DORDERBOOK_ALLOC_GUARD, the global operator new/delete.
+ */
+
+#include "../include/alloc_guard.hpp"
+
+#ifdef ORDERBOOK_ALLOC_GUARD
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+
+namespace {
+
+// Тривиальные thread_local — без динамической инициализации, сами ничего не выделяют
+thread_local bool t_armed = false;
+thread_local AllocationGuard::Mode t_mode = AllocationGuard::Mode::abort;
+thread_local size_t t_counted = 0;
+
+void check(size_t size) {
+    if (!t_armed) return;
+    if (t_mode == AllocationGuard::Mode::count) {
+        ++t_counted;
+        return;
+    }
+    // Сообщение — без кучи: snprintf в стек и write
+    t_armed = false;
+    char message[96];
+    int n = std::snprintf(message, sizeof(message), "FATAL: heap allocation of %zu bytes under AllocationGuard\n", size);
+    if (n > 0) (void)!::write(STDERR_FILENO, message, static_cast<size_t>(n));
+    std::abort();
+}
+
+void* allocate(size_t size) {
+    check(size);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* allocate_aligned(size_t size, std::align_val_t align) {
+    check(size);
+    size_t alignment = static_cast<size_t>(align);
+    size = (size + alignment - 1) / alignment * alignment; // aligned_alloc: кратно выравниванию
+    if (void* p = std::aligned_alloc(alignment, size ? size : alignment)) return p;
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+AllocationGuard::AllocationGuard(Mode mode) : m_was_armed(t_armed), m_was_mode(t_mode), m_start(t_counted) {
+    t_armed = true;
+    t_mode = mode;
+}
+
+AllocationGuard::~AllocationGuard() {
+    t_armed = m_was_armed;
+    t_mode = m_was_mode;
+}
+
+size_t AllocationGuard::allocations() const { return t_counted - m_start; }
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, std::align_val_t align) { return allocate_aligned(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return allocate_aligned(size, align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+#endif // ORDERBOOK_ALLOC_GUARD
@@ -3,18 +3,11 @@
 #include <random>
 #include <chrono>
 #include "../include/orderbook.hpp"
+#include "../include/tsc_clock.hpp"
 
-// Точное измерение через rdtsc (если x86)
-#ifdef __x86_64__
-#include <x86intrin.h>
-uint64_t now() { return __rdtsc(); }
-double cycles_to_ns(uint64_t cycles) {
-    // Предположим, CPU = 3 GHz → 1 такт = 0.333 нс
-    return cycles / 3.0;
-}
-#else
-auto now() { return std::chrono::high_resolution_clock::now(); }
-#endif
+// Такты TSC; частота калибруется при старте, а не предполагается
+uint64_t now() { return tsc_now(); }
+double cycles_to_ns(uint64_t cycles) { return cycles * TscClock::ns_per_tick(); }
 
 int main() {
     const int NUM_ORDERS = 10000;
@@ -45,16 +38,8 @@ int main() {
     auto exec_time = now() - start;
 
     // --- Вывод результатов ---
-#ifdef __x86_64__
     std::cout << "Fill time: " << cycles_to_ns(fill_time) / 1000.0 << " mcs\n";
     std::cout << "Exec time per order: " << cycles_to_ns(exec_time) / 2000.0 << " ns\n";
-#else
-    auto to_micros = [](auto dur) {
-        return std::chrono::duration_cast<std::chrono::microseconds>(dur).count();
-    };
-    std::cout << "Fill time: " << to_micros(fill_time) << " mcs\n";
-    std::cout << "Exec time per order: " << to_micros(exec_time) * 1000 / 2000 << " ns\n";
-#endif
 
     // Пример: как получить лучшую цену
     int best_bid = book.best_quote(BookSide::bid);
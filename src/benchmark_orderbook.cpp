@@ -4,19 +4,63 @@
     #include <cassert>
     #include <chrono>
     #include <algorithm>
-    #include <fstream>
 
     // Include your existing headers
     #include "../include/helpers.hpp"
     #include "../include/enums.hpp"
     #include "../include/order.hpp"
     #include "../include/orderbook.hpp"
+    #include "../include/matching_engine.hpp"
+    #include "../include/huge_page_resource.hpp"
+    #include <cstring>
+    #include <memory>
+    #include <thread>
 
     using namespace std;
 
-    int main() {
-        // Create an empty orderbook (no dummy data)
-        Orderbook orderbook(false);
+    // Одна строка на тип операции; гистограмма — в <file> для plot_dists.py
+    static void report(const char* name, const LatencyHistogram& h, const char* file) {
+        cout << name << ": " << h.count() << " ops, mean " << h.mean() << " ns, p50 " << h.percentile(0.50)
+             << " ns, p99 " << h.percentile(0.99) << " ns, p99.9 " << h.percentile(0.999)
+             << " ns, max " << h.max() << " ns\n";
+        h.write(file);
+    }
+
+    int main(int argc, char** argv) {
+        bool use_hugepages = false;
+        BookConfig config;
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--hugepages") == 0) use_hugepages = true;
+            else if (std::strncmp(argv[i], "--prefetch-distance=", 20) == 0) {
+                config.prefetch_distance = std::strtoul(argv[i] + 20, nullptr, 10);
+            }
+        }
+
+        // Create an empty orderbook (no dummy data); с --hugepages пул, уровни
+        // и битмапы берутся из заранее отображённой арены на huge pages
+        std::unique_ptr<HugePageResource> arena;
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+        if (use_hugepages) {
+            HugePageResource::Options options;
+            options.lock = true;
+            arena = std::make_unique<HugePageResource>(config.arena_bytes(), options);
+            mr = arena.get();
+            cout << "Arena: " << (arena->capacity() >> 20) << " MB, " << arena->backing_name()
+                 << (arena->locked() ? ", locked" : "") << endl;
+        }
+        Orderbook orderbook(config, mr);
+        cout << "Order layout: " << ORDER_LAYOUT << endl;
+
+        // First orders after construction: the cost of touching cold memory
+        {
+            uint64_t t0 = unix_time();
+            uint64_t first_id = orderbook.add_order(100, 10000, BookSide::ask);
+            uint64_t t1 = unix_time();
+            orderbook.handle_order(OrderType::market, 100, Side::buy);
+            uint64_t t2 = unix_time();
+            cout << "First order latency: add " << (t1 - t0) << " ns, market " << (t2 - t1) << " ns"
+                 << (first_id ? "" : " (rejected)") << "\n";
+        }
 
         // Random engine setup
         std::mt19937 rng(std::random_device{}()); // Mersenne Twister
@@ -42,45 +86,29 @@
 
         // Collect all IDs for modifies/deletes
         vector<uint64_t> all_ids;
-        // Bids
-        // Bids: идём от высоких цен к низким
-        for (int price_cents = MAX_PRICE_CENTS; price_cents >= MIN_PRICE_CENTS; --price_cents) {
-            size_t idx = price_cents - MIN_PRICE_CENTS;
-            auto& dq = orderbook.get_bids()[idx];
-            if (!dq.empty()) {
-                for (auto& orderPtr : dq) {
-                    all_ids.push_back(orderPtr->id);
-                }
-            }
-        }
-
-        // Asks: идём от низких цен к высоким
-        for (int price_cents = MIN_PRICE_CENTS; price_cents <= MAX_PRICE_CENTS; ++price_cents) {
-            size_t idx = price_cents - MIN_PRICE_CENTS;
-            auto& dq = orderbook.get_asks()[idx];
-            if (!dq.empty()) {
-                for (auto& orderPtr : dq) {
-                    all_ids.push_back(orderPtr->id);
-                }
-            }
-        }
+        // Bids: идём от высоких цен к низким, asks: от низких к высоким
+        orderbook.for_each_order(BookSide::bid, [&](const Order& order) {
+            all_ids.push_back(order.id);
+        });
+        orderbook.for_each_order(BookSide::ask, [&](const Order& order) {
+            all_ids.push_back(order.id);
+        });
 
         // Shuffle them so they're not in strictly sorted or grouped order
         std::shuffle(all_ids.begin(), all_ids.end(), rng);
         cout << "Created " << all_ids.size() << " orders total." << endl;
 
         // ----------------------------------------------------------------------------------
-        // Files to record times for distribution plotting
+        // Per-operation latency: TSC ticks converted with the rate calibrated at startup,
+        // recorded into HDR histograms and dumped as *_hist.bin for plot_dists.py
         // ----------------------------------------------------------------------------------
-        ofstream marketTimesFile("market_times.txt");
-        ofstream modifyTimesFile("modify_times.txt");
-        ofstream deleteTimesFile("delete_times.txt");
+        cout << "TSC: " << TscClock::ghz() << " GHz (calibrated)\n";
+        LatencyHistogram market_hist, modify_hist, delete_hist, limit_hist;
 
         // ----------------------------------------------------------------------------------
         // 2) Random Market Orders
         // ----------------------------------------------------------------------------------
         const int NUM_MARKET_ORDERS = 5000;
-        uint64_t total_market_ns = 0;
 
         std::uniform_int_distribution<int> market_qty_dist(100, 2000);
         for (int i = 0; i < NUM_MARKET_ORDERS; ++i) {
@@ -88,23 +116,16 @@
             Side side = (side_dist(rng) == 0) ? Side::buy : Side::sell;
             int qty = market_qty_dist(rng);
 
-            uint64_t start_t = unix_time();
+            PROFILE_SCOPE(market_hist);
             orderbook.handle_order(OrderType::market, qty, side);
-            uint64_t end_t = unix_time();
-
-            uint64_t duration = end_t - start_t;
-            total_market_ns += duration;
-            marketTimesFile << duration << "\n";
         }
-        double avg_market_ns = static_cast<double>(total_market_ns) / NUM_MARKET_ORDERS;
-        cout << "Average time for " << NUM_MARKET_ORDERS << " market orders: "
-            << avg_market_ns << " ns\n";
+        cout << "(prefetch distance " << orderbook.config().prefetch_distance << ") ";
+        report("Market orders", market_hist, "market_hist.bin");
 
         // ----------------------------------------------------------------------------------
         // 3) Random Modifies (biased towards the middle)
         // ----------------------------------------------------------------------------------
         const int NUM_MODIFIES = 500;
-        uint64_t total_modify_ns = 0;
 
         // Normal distribution centered around the midpoint of all_ids
         double mean_index = all_ids.size() / 2.0;
@@ -128,23 +149,15 @@
             // Biased pick: mostly near the middle, but sometimes edges
             uint64_t randomID = getMiddleBiasedID(normal_dist_mod);
 
-            uint64_t start_t = unix_time();
-            bool ok = orderbook.modify_order(randomID, new_qty);
-            uint64_t end_t = unix_time();
-
-            uint64_t duration = end_t - start_t;
-            total_modify_ns += duration;
-            modifyTimesFile << duration << "\n";
+            PROFILE_SCOPE(modify_hist);
+            orderbook.modify_order(randomID, new_qty);
         }
-        double avg_modify_ns = static_cast<double>(total_modify_ns) / NUM_MODIFIES;
-        cout << "Average time for " << NUM_MODIFIES << " modifies: "
-            << avg_modify_ns << " ns\n";
+        report("Modifies", modify_hist, "modify_hist.bin");
 
         // ----------------------------------------------------------------------------------
         // 4) Random Deletes (biased towards the middle)
         // ----------------------------------------------------------------------------------
         const int NUM_DELETES = 500;
-        uint64_t total_delete_ns = 0;
 
         // We can reuse the same distribution. Or create a separate one if desired.
         std::normal_distribution<double> normal_dist_del(mean_index, stddev_index);
@@ -153,29 +166,15 @@
             // Pick random ID near the middle, occasionally hitting edges
             uint64_t randomID = getMiddleBiasedID(normal_dist_del);
 
-            uint64_t start_t = unix_time();
-            bool ok = orderbook.delete_order(randomID);
-            uint64_t end_t = unix_time();
-
-            uint64_t duration = end_t - start_t;
-            total_delete_ns += duration;
-            deleteTimesFile << duration << "\n";
+            PROFILE_SCOPE(delete_hist);
+            orderbook.delete_order(randomID);
         }
-        double avg_delete_ns = static_cast<double>(total_delete_ns) / NUM_DELETES;
-        cout << "Average time for " << NUM_DELETES << " deletes: "
-            << avg_delete_ns << " ns\n";
-
-        // Close output files for market, modify, and delete operations
-        marketTimesFile.close();
-        modifyTimesFile.close();
-        deleteTimesFile.close();
+        report("Deletes", delete_hist, "delete_hist.bin");
 
         // ----------------------------------------------------------------------------------
         // 5) Random Limit Orders (near best bid/ask, but not improving them)
         // ----------------------------------------------------------------------------------
         const int NUM_LIMIT_ORDERS = 1000;
-        ofstream limitTimesFile("limit_times.txt");
-        uint64_t total_limit_ns = 0;
 
         // Normal distribution for price offset (adjust standard deviation as needed)
         std::normal_distribution<double> price_offset(0, 0.5); 
@@ -217,19 +216,152 @@
             limit_price = 100.00; 
         }
 
-            uint64_t start_t = unix_time();
+            PROFILE_SCOPE(limit_hist);
             // Assumes handle_order can take a limit order with a specified price.
             orderbook.handle_order(OrderType::limit, qty, side, static_cast<int32_t>(limit_price * 100.0));
-            uint64_t end_t = unix_time();
+        }
+        report("Limit orders", limit_hist, "limit_hist.bin");
 
-            uint64_t duration = end_t - start_t;
-            total_limit_ns += duration;
-            limitTimesFile << duration << "\n";
+        // ----------------------------------------------------------------------------------
+        // 6) Commands through the SPSC rings to a dedicated matching thread
+        // ----------------------------------------------------------------------------------
+        const int NUM_RING_COMMANDS = 200000;
+        auto engine = std::make_unique<MatchingEngine>(1 << 14);
+
+        // Ядро для потока сопоставления, если их больше одного
+        int engine_cpu = std::thread::hardware_concurrency() > 1 ? 1 : -1;
+        engine->start(engine_cpu);
+
+        // Пассивные лимитки вокруг $100 и рыночные ордера, которые их съедают
+        std::uniform_int_distribution<int> ring_price_dist(9900, 10100);
+        vector<Command> ring_commands(NUM_RING_COMMANDS);
+        for (int i = 0; i < NUM_RING_COMMANDS; ++i) {
+            Command& cmd = ring_commands[i];
+            cmd.seq = i;
+            cmd.type = CommandType::order;
+            cmd.quantity = qty_dist(rng);
+            if (i % 4 == 3) {
+                cmd.order_type = OrderType::market;
+                cmd.side = (side_dist(rng) == 0) ? Side::buy : Side::sell;
+            } else {
+                cmd.order_type = OrderType::limit;
+                cmd.price_cents = ring_price_dist(rng);
+                cmd.side = (cmd.price_cents < 10000) ? Side::buy : Side::sell;
+            }
+        }
+
+        // Throughput: keep the ring full, drain results as they come
+        uint64_t start_t = unix_time();
+        int sent = 0, received = 0;
+        Result result;
+        while (received < NUM_RING_COMMANDS) {
+            while (sent < NUM_RING_COMMANDS && engine->submit(ring_commands[sent])) ++sent;
+            bool got = false;
+            while (engine->poll(result)) { ++received; got = true; }
+            if (!got) std::this_thread::yield();
+        }
+        uint64_t elapsed_ns = unix_time() - start_t;
+        cout << "Ring throughput: " << (NUM_RING_COMMANDS * 1e9 / elapsed_ns) / 1e6
+             << " M commands/s\n";
+
+        // Round trip: one command in flight at a time. Крутимся на pause, но
+        // периодически уступаем ядро — иначе на одном CPU ждём целый квант
+        auto backoff = [spins = 0]() mutable {
+            if (++spins % 256 == 0) std::this_thread::yield();
+            else cpu_relax();
+        };
+        // Свежий движок: фаза пропускной способности уже изменила книгу и
+        // израсходовала эти seq, а замер должен видеть тот же поток с нуля
+        engine->stop();
+        engine = std::make_unique<MatchingEngine>(1 << 14);
+        engine->start(engine_cpu);
+        const int NUM_ROUNDTRIPS = 20000;
+        uint64_t total_rtt_ns = 0;
+        for (int i = 0; i < NUM_ROUNDTRIPS; ++i) {
+            uint64_t t0 = unix_time();
+            while (!engine->submit(ring_commands[i])) backoff();
+            while (!engine->poll(result)) backoff();
+            total_rtt_ns += unix_time() - t0;
+        }
+        engine->stop();
+        cout << "Average ring round trip for " << NUM_ROUNDTRIPS << " commands: "
+             << static_cast<double>(total_rtt_ns) / NUM_ROUNDTRIPS << " ns\n";
+
+        // ----------------------------------------------------------------------------------
+        // 7) Deep-level sweeps: the fill loop walks long FIFOs, which is where the
+        //    AoS and SoA order layouts differ (compare with `make layouts`)
+        // ----------------------------------------------------------------------------------
+        const int SWEEP_LEVELS = 64;
+        const int ORDERS_PER_LEVEL = 500;
+        const int NUM_SWEEPS = 20;
+
+        // Та же развёртка с разной дальностью программной предвыборки
+        for (size_t distance : {size_t{0}, size_t{1}, size_t{4}}) {
+            uint64_t total_sweep_ns = 0;
+            int64_t swept_orders = 0;
+            uint64_t worst_sweep_ns = 0;
+
+            for (int r = 0; r < NUM_SWEEPS; ++r) {
+                Orderbook deep(false);
+                deep.set_prefetch_distance(distance);
+                for (int j = 0; j < ORDERS_PER_LEVEL; ++j) {
+                    for (int l = 0; l < SWEEP_LEVELS; ++l) {
+                        deep.add_order(10, 10000 + l, BookSide::ask); // уровни перемешаны в пуле
+                    }
+                }
+
+                uint64_t t0 = unix_time();
+                auto [units, notional] = deep.handle_order(OrderType::market, SWEEP_LEVELS * ORDERS_PER_LEVEL * 10, Side::buy);
+                uint64_t sweep_ns = unix_time() - t0;
+                total_sweep_ns += sweep_ns;
+                worst_sweep_ns = std::max(worst_sweep_ns, sweep_ns);
+                swept_orders += units / 10;
+            }
+            cout << "Average sweep cost per resting order (" << ORDER_LAYOUT << ", prefetch distance "
+                 << distance << "): " << static_cast<double>(total_sweep_ns) / swept_orders
+                 << " ns, worst sweep " << worst_sweep_ns / 1000 << " us\n";
+        }
+
+        // ----------------------------------------------------------------------------------
+        // 8) Batched commands: the same stream applied through process_batch in
+        //    batches of 1, 8 and 64 (limit orders, market orders and cancels)
+        // ----------------------------------------------------------------------------------
+        const int NUM_BATCH_COMMANDS = 200000;
+        vector<Command> batch_commands(NUM_BATCH_COMMANDS);
+        {
+            // ID при детерминированном пуле предсказуем: прогоняем поток один раз
+            Orderbook probe(false);
+            vector<uint64_t> rested;
+            for (int i = 0; i < NUM_BATCH_COMMANDS; ++i) {
+                Command& cmd = batch_commands[i];
+                cmd.seq = i;
+                if (i % 5 == 4 && !rested.empty()) {
+                    size_t k = rng() % rested.size();
+                    cmd.type = CommandType::cancel;
+                    cmd.order_id = rested[k];
+                    rested[k] = rested.back();
+                    rested.pop_back();
+                } else {
+                    cmd = ring_commands[i];
+                    cmd.seq = i;
+                }
+                Result r = probe.execute(cmd);
+                if (r.order_id) rested.push_back(r.order_id);
+            }
+        }
+
+        vector<Result> batch_results(NUM_BATCH_COMMANDS);
+        for (size_t batch_size : {size_t{1}, size_t{8}, size_t{64}}) {
+            Orderbook batch_book(false);
+            uint64_t t0 = unix_time();
+            for (size_t i = 0; i < batch_commands.size(); i += batch_size) {
+                size_t n = std::min(batch_size, batch_commands.size() - i);
+                batch_book.process_batch({batch_commands.data() + i, n}, {batch_results.data() + i, n});
+            }
+            uint64_t batch_ns = unix_time() - t0;
+            cout << "Batch size " << batch_size << ": "
+                 << (NUM_BATCH_COMMANDS * 1e9 / batch_ns) / 1e6 << " M messages/s\n";
         }
-        double avg_limit_ns = static_cast<double>(total_limit_ns) / NUM_LIMIT_ORDERS;
-        cout << "Average time for " << NUM_LIMIT_ORDERS << " limit orders: "
-            << avg_limit_ns << " ns\n";
-        limitTimesFile.close();
 
         return 0;
     }
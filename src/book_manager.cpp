@@ -0,0 +1,33 @@
+/**
+ * @file book_manager.cpp
+ * @brief This file contains the implementation of the BookManager class.
+ */
+
+#include <stdexcept>
+#include "../include/book_manager.hpp"
+
+BookManager::BookManager(size_t initial_arena_bytes, std::pmr::memory_resource* upstream)
+    : m_arena(initial_arena_bytes, upstream) {}
+
+BookManager::~BookManager() {
+    // Память вернёт арена целиком, но деструкторы книг должны отработать
+    std::pmr::polymorphic_allocator<Orderbook> alloc(&m_arena);
+    for (Orderbook* book : m_books) {
+        if (book) alloc.delete_object(book);
+    }
+}
+
+Orderbook& BookManager::create_book(uint32_t symbol, const BookConfig& config) {
+    if (symbol < m_books.size() && m_books[symbol]) {
+        throw std::invalid_argument("Book already exists for symbol");
+    }
+    if (symbol >= m_books.size()) {
+        m_books.resize(symbol + 1, nullptr);
+    }
+
+    std::pmr::polymorphic_allocator<Orderbook> alloc(&m_arena);
+    Orderbook* book = alloc.new_object<Orderbook>(config, &m_arena);
+    m_books[symbol] = book;
+    ++m_book_count;
+    return *book;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file depth_scan.cpp
+ * @brief Scalar, AVX2 and AVX-512 kernels behind scan_levels(), picked at runtime.
+ */
+
+#include <cstddef>
+#include <vector>
+#include "../include/depth_scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEPTH_SCAN_X86 1
+#endif
+
+// Ядра читают заголовок уровня как четыре 64-битных слова: объём во втором, резерв в третьем
+static_assert(offsetof(PriceLevel, quantity) == 8 && offsetof(PriceLevel, reserve) == 16,
+              "depth scan kernels expect quantity and reserve in the 2nd and 3rd qword");
+
+namespace {
+
+// Продолжает скан с уровня r.levels по одному
+LevelScan scan_tail(const PriceLevel* start, size_t n, ptrdiff_t step, int64_t cap, LevelScan r) {
+    for (size_t i = r.levels; i < n; ++i) {
+        const PriceLevel& level = start[step * static_cast<ptrdiff_t>(i)];
+        int64_t size = level.quantity + level.reserve;
+        if (r.quantity + size >= cap) break;
+        r.quantity += size;
+        r.weighted += size * static_cast<int64_t>(i);
+        r.levels = i + 1;
+    }
+    return r;
+}
+
+#ifdef DEPTH_SCAN_X86
+
+// 4 уровня за шаг: по одной 256-битной загрузке на заголовок
+__attribute__((target("avx2")))
+LevelScan scan_avx2(const PriceLevel* start, size_t n, bool descending, int64_t cap) {
+    ptrdiff_t step = descending ? -1 : 1;
+    LevelScan r;
+    __m256i lanes = _mm256_setzero_si256(); // объём j-го уровня блока, по всем блокам
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const PriceLevel* p = start + step * static_cast<ptrdiff_t>(i);
+        __m256i v0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i v1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(p + step));
+        __m256i v2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(p + 2 * step));
+        __m256i v3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(p + 3 * step));
+        // unpackhi: [q0 q1 | x x], unpacklo: [x x | r0 r1]
+        __m128i s01 = _mm_add_epi64(_mm256_castsi256_si128(_mm256_unpackhi_epi64(v0, v1)),
+                                    _mm256_extracti128_si256(_mm256_unpacklo_epi64(v0, v1), 1));
+        __m128i s23 = _mm_add_epi64(_mm256_castsi256_si128(_mm256_unpackhi_epi64(v2, v3)),
+                                    _mm256_extracti128_si256(_mm256_unpacklo_epi64(v2, v3), 1));
+        __m128i pair = _mm_add_epi64(s01, s23);
+        int64_t sum = _mm_cvtsi128_si64(pair) + _mm_extract_epi64(pair, 1);
+        if (r.quantity + sum >= cap) break; // этот блок добивает cap — досчитываем по одному
+        r.quantity += sum;
+        r.weighted += static_cast<int64_t>(i) * sum;
+        lanes = _mm256_add_epi64(lanes, _mm256_set_m128i(s23, s01));
+    }
+    alignas(32) int64_t l[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(l), lanes);
+    r.weighted += l[1] + 2 * l[2] + 3 * l[3];
+    r.levels = i;
+    return scan_tail(start, n, step, cap, r);
+}
+
+// 8 уровней за шаг: 4 загрузки по два заголовка и перестановки объёма/резерва в плотные векторы
+__attribute__((target("avx512f")))
+LevelScan scan_avx512(const PriceLevel* start, size_t n, bool descending, int64_t cap) {
+    ptrdiff_t step = descending ? -1 : 1;
+    // По возрастанию загрузка с p даёт [уровень 0 | уровень 1], по убыванию с p-1 — [1 | 0]
+    const __m512i pick = descending ? _mm512_set_epi64(10, 14, 2, 6, 9, 13, 1, 5)
+                                    : _mm512_set_epi64(14, 10, 6, 2, 13, 9, 5, 1);
+    const __m512i low_halves = _mm512_set_epi64(11, 10, 9, 8, 3, 2, 1, 0);
+    const __m512i high_halves = _mm512_set_epi64(15, 14, 13, 12, 7, 6, 5, 4);
+    ptrdiff_t back = descending ? -1 : 0;
+
+    LevelScan r;
+    __m512i lanes = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const PriceLevel* p = start + step * static_cast<ptrdiff_t>(i);
+        __m512i a = _mm512_loadu_si512(p + back);
+        __m512i b = _mm512_loadu_si512(p + 2 * step + back);
+        __m512i c = _mm512_loadu_si512(p + 4 * step + back);
+        __m512i d = _mm512_loadu_si512(p + 6 * step + back);
+        __m512i ab = _mm512_permutex2var_epi64(a, pick, b); // [q0..q3 | r0..r3]
+        __m512i cd = _mm512_permutex2var_epi64(c, pick, d); // [q4..q7 | r4..r7]
+        __m512i size = _mm512_add_epi64(_mm512_permutex2var_epi64(ab, low_halves, cd),
+                                        _mm512_permutex2var_epi64(ab, high_halves, cd));
+        int64_t sum = _mm512_reduce_add_epi64(size);
+        if (r.quantity + sum >= cap) break;
+        r.quantity += sum;
+        r.weighted += static_cast<int64_t>(i) * sum;
+        lanes = _mm512_add_epi64(lanes, size);
+    }
+    alignas(64) int64_t l[8];
+    _mm512_store_si512(l, lanes);
+    for (int j = 1; j < 8; ++j) r.weighted += j * l[j];
+    r.levels = i;
+    return scan_tail(start, n, step, cap, r);
+}
+
+#endif
+
+std::vector<ScanKernel> supported_kernels() {
+    std::vector<ScanKernel> kernels;
+#ifdef DEPTH_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) kernels.push_back({"avx512", scan_avx512});
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", scan_avx2});
+#endif
+    kernels.push_back({"scalar", scan_levels_scalar});
+    return kernels;
+}
+
+} // namespace
+
+LevelScan scan_levels_scalar(const PriceLevel* start, size_t n, bool descending, int64_t cap) {
+    return scan_tail(start, n, descending ? -1 : 1, cap, LevelScan{});
+}
+
+std::span<const ScanKernel> scan_kernels() {
+    static const std::vector<ScanKernel> kernels = supported_kernels();
+    return kernels;
+}
+
+LevelScan scan_levels(const PriceLevel* start, size_t n, bool descending, int64_t cap) {
+    static const ScanKernel best = scan_kernels().front();
+    return best.fn(start, n, descending, cap);
+}
+
+const char* scan_levels_isa() {
+    return scan_kernels().front().isa;
+}
@@ -2,6 +2,8 @@
 #include <fstream>
 #include <iostream>
 #include <utility>
+#include <pthread.h>
+#include <sched.h>
 
 using std::cout;
 using std::cerr;
@@ -22,9 +24,19 @@ void print_file_contents(std::string_view file_path){
     file.close();
 }
 
-void print_fill(std::pair<int, double> fill, int quantity, u_int64_t start_time, u_int64_t end_time){
+void print_fill(std::pair<int, int64_t> fill, int quantity, u_int64_t start_time, u_int64_t end_time){
+    double average_price = fill.first ? fill.second / 100.0 / fill.first : 0.0;
     cout << "\033[33mFilled " << fill.first << "/" << quantity << " units @ $" 
-        << fill.second/fill.first << " average price. Time taken: " 
+        << average_price << " average price. Time taken: " 
         << (end_time-start_time) << " nano seconds\033[0m" << "\n";
 }
 
+
+bool pin_current_thread(int cpu){
+    if (cpu < 0) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
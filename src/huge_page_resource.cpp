@@ -0,0 +1,109 @@
+/**
+ * @file huge_page_resource.cpp
+ * @brief This file contains the implementation of the HugePageResource class.
+ */
+
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../include/huge_page_resource.hpp"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace {
+
+constexpr size_t HUGE_2MB = size_t{2} << 20;
+constexpr size_t HUGE_1GB = size_t{1} << 30;
+
+size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+} // namespace
+
+HugePageResource::HugePageResource(size_t bytes, Options options, std::pmr::memory_resource* upstream)
+    : m_upstream(upstream) {
+    if (bytes == 0) bytes = 1;
+
+    // 1) Зарезервированные huge pages (vm.nr_hugepages)
+    size_t huge = options.use_1gb_pages ? HUGE_1GB : HUGE_2MB;
+    size_t size = round_up(bytes, huge);
+    int huge_flag = options.use_1gb_pages ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_flag, -1, 0);
+    if (p != MAP_FAILED) {
+        m_map = p;
+        m_map_size = size;
+        m_base = static_cast<char*>(p);
+        m_size = size;
+        m_backing = Backing::hugetlb;
+    } else {
+        // 2) Обычное отображение, выровненное на 2 MB, с просьбой о THP.
+        //    Берём с запасом и отрезаем невыровненные края.
+        size = round_up(bytes, HUGE_2MB);
+        size_t map_size = size + HUGE_2MB;
+        p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+
+        char* raw = static_cast<char*>(p);
+        char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(raw), HUGE_2MB));
+        if (aligned > raw) munmap(raw, aligned - raw);
+        char* end = aligned + size;
+        if (raw + map_size > end) munmap(end, raw + map_size - end);
+
+        m_map = aligned;
+        m_map_size = size;
+        m_base = aligned;
+        m_size = size;
+        m_backing = (madvise(aligned, size, MADV_HUGEPAGE) == 0) ? Backing::transparent : Backing::normal;
+    }
+
+    // Предварительно трогаем каждую страницу, чтобы не ловить page fault в торговле
+    if (options.prefault) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (size_t off = 0; off < m_size; off += page) {
+            m_base[off] = 0;
+        }
+    }
+
+    if (options.lock) {
+        m_locked = mlock(m_base, m_size) == 0; // без CAP_IPC_LOCK / ulimit -l может не выйти
+    }
+}
+
+HugePageResource::~HugePageResource() {
+    if (m_locked) munlock(m_base, m_size);
+    if (m_map) munmap(m_map, m_map_size);
+}
+
+const char* HugePageResource::backing_name() const {
+    switch (m_backing) {
+        case Backing::hugetlb: return "hugetlb";
+        case Backing::transparent: return "transparent huge pages";
+        default: return "normal pages";
+    }
+}
+
+void* HugePageResource::do_allocate(size_t bytes, size_t alignment) {
+    size_t offset = round_up(m_used, alignment);
+    if (offset + bytes <= m_size) {
+        m_used = offset + bytes;
+        return m_base + offset;
+    }
+    // Арена закончилась — обслуживаем из upstream, но учитываем
+    m_overflow_bytes += bytes;
+    return m_upstream->allocate(bytes, alignment);
+}
+
+void HugePageResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    char* c = static_cast<char*>(p);
+    if (c >= m_base && c < m_base + m_size) return; // память арены освобождается целиком
+    m_upstream->deallocate(p, bytes, alignment);
+}
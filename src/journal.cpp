@@ -0,0 +1,226 @@
+/**
+ * @file journal.cpp
+ * @brief This file contains the implementation of the Journal and JournalReader classes.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/journal.hpp"
+#include "../include/orderbook.hpp"
+
+namespace {
+
+constexpr char JOURNAL_MAGIC[8] = {'O', 'B', 'J', 'R', 'N', 'L', '0', '1'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+
+// Сколько записей отдаём apply_in_order за раз при воспроизведении
+constexpr size_t REPLAY_BATCH = 256;
+
+[[noreturn]] void fail(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+bool valid_header(const JournalHeader& header) {
+    return std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+           header.version == JOURNAL_VERSION && header.record_size == sizeof(Command) &&
+           header.count <= header.capacity;
+}
+
+size_t file_bytes(size_t capacity) { return sizeof(JournalHeader) + capacity * sizeof(Command); }
+
+JournalHeader::Book book_fields(const BookConfig& config) {
+    JournalHeader::Book book{};
+    book.min_price_cents = config.min_price_cents;
+    book.max_price_cents = config.max_price_cents;
+    book.tick_size = config.tick_size;
+    book.compact_percent = config.compact_percent;
+    book.max_pool_capacity = config.max_pool_capacity;
+    book.cancel_policy = static_cast<uint8_t>(config.cancel_policy);
+    book.recorded = 1;
+    return book;
+}
+
+size_t page_size() { return static_cast<size_t>(sysconf(_SC_PAGESIZE)); }
+
+} // namespace
+
+Journal::Journal(const std::string& path, size_t capacity, Options options) : m_options(options) {
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) fail("journal: open");
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) fail("journal: fstat");
+
+    JournalHeader existing{};
+    bool fresh = st.st_size == 0;
+    if (!fresh) {
+        if (static_cast<size_t>(st.st_size) < sizeof(JournalHeader) ||
+            pread(m_fd, &existing, sizeof(existing), 0) != static_cast<ssize_t>(sizeof(existing)) ||
+            !valid_header(existing) || static_cast<size_t>(st.st_size) < file_bytes(existing.capacity)) {
+            close(m_fd);
+            throw std::runtime_error("journal: " + path + " is not a valid journal");
+        }
+        capacity = std::max<size_t>(capacity, existing.capacity);
+    }
+
+    map(capacity);
+
+    if (fresh) {
+        std::memcpy(m_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        m_header->version = JOURNAL_VERSION;
+        m_header->record_size = sizeof(Command);
+        m_header->count = 0;
+    }
+    m_header->capacity = capacity;
+    m_synced_count = m_header->count;
+}
+
+void Journal::map(size_t capacity) {
+    size_t bytes = file_bytes(capacity);
+
+    // Место на диске выделяем сразу: запись в отображение не должна ловить
+    // SIGBUS на переполненной ФС. Где fallocate не поддерживается — ftruncate
+    int err = posix_fallocate(m_fd, 0, static_cast<off_t>(bytes));
+    if (err != 0 && ftruncate(m_fd, static_cast<off_t>(bytes)) != 0) {
+        close(m_fd);
+        fail("journal: allocate");
+    }
+
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+        close(m_fd);
+        fail("journal: mmap");
+    }
+    m_map = p;
+    m_map_size = bytes;
+    m_header = static_cast<JournalHeader*>(p);
+    m_records = reinterpret_cast<Command*>(static_cast<char*>(p) + sizeof(JournalHeader));
+}
+
+Journal::~Journal() {
+    if (m_map) {
+        flush();
+        munmap(m_map, m_map_size);
+    }
+    if (m_fd >= 0) close(m_fd);
+}
+
+void Journal::flush() {
+    m_unsynced = 0;
+    size_t count = m_header->count;
+    if (count == m_synced_count) return;
+
+    // Только страницы с новыми записями, выровненные вниз до начала страницы
+    char* base = static_cast<char*>(m_map);
+    size_t page = page_size();
+    size_t begin = (sizeof(JournalHeader) + m_synced_count * sizeof(Command)) / page * page;
+    size_t end = sizeof(JournalHeader) + count * sizeof(Command);
+    msync(base + begin, end - begin, MS_ASYNC);
+    if (begin != 0) msync(base, page, MS_ASYNC); // счётчик в заголовке
+    m_synced_count = count;
+}
+
+void Journal::sync() {
+    size_t end = sizeof(JournalHeader) + m_header->count * sizeof(Command);
+    if (msync(m_map, end, MS_SYNC) != 0) fail("journal: msync");
+    m_synced_count = m_header->count;
+    m_unsynced = 0;
+}
+
+void Journal::warm_up(size_t records) {
+    size_t count = m_header->count;
+    size_t end = file_bytes(std::min<size_t>(count + records, m_header->capacity));
+    // Страницы за хвостом никто не читает: пишем в каждую её же байт
+    char* base = static_cast<char*>(m_map);
+    size_t page = page_size();
+    for (size_t offset = file_bytes(count) / page * page; offset < end; offset += page) {
+        volatile char* p = base + offset;
+        *p = *p;
+    }
+}
+
+void Journal::record_book_config(const BookConfig& config) {
+    JournalHeader::Book book = book_fields(config);
+    if (m_header->book.recorded) {
+        // Продолжаем чужой журнал — так же строго, как load_snapshot
+        if (std::memcmp(&m_header->book, &book, sizeof(book)) != 0) {
+            throw std::runtime_error("journal: book config differs");
+        }
+        return;
+    }
+    m_header->book = book;
+}
+
+JournalReader::JournalReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) fail("journal: open");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        fail("journal: fstat");
+    }
+    size_t bytes = static_cast<size_t>(st.st_size);
+    if (bytes < sizeof(JournalHeader)) {
+        close(fd);
+        throw std::runtime_error("journal: " + path + " is not a valid journal");
+    }
+
+    void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // отображение держит файл само
+    if (p == MAP_FAILED) fail("journal: mmap");
+    m_map = p;
+    m_map_size = bytes;
+
+    const auto* header = static_cast<const JournalHeader*>(p);
+    if (!valid_header(*header)) {
+        munmap(p, bytes);
+        m_map = nullptr;
+        throw std::runtime_error("journal: " + path + " is not a valid journal");
+    }
+    refresh();
+    madvise(p, bytes, MADV_SEQUENTIAL);
+}
+
+size_t JournalReader::refresh() {
+    const auto* header = static_cast<const JournalHeader*>(m_map);
+    // Парно release-записи счётчика в Journal::append
+    uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    // Обрезанный файл читаем до последней целой записи
+    count = std::min<uint64_t>(count, (m_map_size - sizeof(JournalHeader)) / sizeof(Command));
+    m_records = {reinterpret_cast<const Command*>(static_cast<const char*>(m_map) + sizeof(JournalHeader)), count};
+    return count;
+}
+
+bool JournalReader::book_config(BookConfig& config) const {
+    const JournalHeader::Book& book = static_cast<const JournalHeader*>(m_map)->book;
+    if (!book.recorded) return false;
+    config.min_price_cents = book.min_price_cents;
+    config.max_price_cents = book.max_price_cents;
+    config.tick_size = book.tick_size;
+    config.compact_percent = book.compact_percent;
+    config.max_pool_capacity = book.max_pool_capacity;
+    config.cancel_policy = static_cast<CancelPolicy>(book.cancel_policy);
+    return true;
+}
+
+JournalReader::~JournalReader() {
+    if (m_map) munmap(m_map, m_map_size);
+}
+
+size_t replay_journal(std::span<const Command> records, Orderbook& book) {
+    Result results[REPLAY_BATCH]; // ответы при воспроизведении не нужны
+    size_t applied = 0;
+    while (applied < records.size()) {
+        size_t n = std::min(REPLAY_BATCH, records.size() - applied);
+        applied += book.apply_in_order(records.subspan(applied, n), {results, n});
+    }
+    return applied;
+}
@@ -53,7 +53,7 @@ int main(){
                     << " order for " << quantity << " units.." << "\n";
 				
 				u_int64_t start_time = unix_time();
-                std::pair<int,double> fill = ob.handle_order(order_type, quantity, side);
+                std::pair<int,int64_t> fill = ob.handle_order(order_type, quantity, side);
 				u_int64_t end_time = unix_time();
 			    
                 print_fill(fill, quantity, start_time, end_time);
@@ -67,7 +67,7 @@ int main(){
                     << " order for " << quantity << " units @ $" << price << ".." << "\n";
 
 				u_int64_t start_time = unix_time();
-                std::pair<int,double> fill = ob.handle_order(order_type, quantity, side, price_cents);
+                std::pair<int,int64_t> fill = ob.handle_order(order_type, quantity, side, price_cents);
 				u_int64_t end_time = unix_time();
 
                 print_fill(fill, quantity, start_time, end_time);
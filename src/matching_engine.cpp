@@ -0,0 +1,123 @@
+/**
+ * @file matching_engine.cpp
+ * @brief This file contains the implementation of the MatchingEngine class.
+ */
+
+#include <optional>
+#include <thread>
+#include "../include/alloc_guard.hpp"
+#include "../include/matching_engine.hpp"
+
+// Сколько пустых проходов крутимся на pause, прежде чем уступить ядро
+static const int IDLE_SPINS_BEFORE_YIELD = 1024;
+// Сколько команд забираем из одного кольца за проход, чтобы не голодало второе
+static const int MAX_BURST = 64;
+// Сколько уровней с надгробиями уплотняем за пустой проход (CancelPolicy::tombstone)
+static const size_t IDLE_COMPACT_LEVELS = 4;
+
+MatchingEngine::MatchingEngine(size_t ring_capacity)
+    : m_inbound(ring_capacity), m_shared_inbound(ring_capacity), m_outbound(ring_capacity) {}
+
+MatchingEngine::MatchingEngine(const BookConfig& config, size_t ring_capacity)
+    : m_book(config), m_inbound(ring_capacity), m_shared_inbound(ring_capacity), m_outbound(ring_capacity) {}
+
+MatchingEngine::~MatchingEngine() {
+    stop();
+}
+
+void MatchingEngine::start(int cpu) {
+    if (m_running.exchange(true)) return;
+    m_thread = std::thread(&MatchingEngine::run, this, cpu);
+}
+
+void MatchingEngine::stop() {
+    if (!m_running.exchange(false)) return;
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void MatchingEngine::publish(const Result& result) {
+    // Обратное давление: ждём, пока потребитель заберёт результаты
+    while (!m_outbound.try_push(result)) {
+        cpu_relax();
+    }
+}
+
+void MatchingEngine::maybe_checkpoint(size_t applied) {
+    if (!m_checkpoint_interval || !m_journal) return;
+    m_since_checkpoint += applied;
+    if (m_since_checkpoint < m_checkpoint_interval) return;
+    // Digest после всех уже записанных команд; журнал полон — пропускаем до следующего раза
+    Command checkpoint;
+    checkpoint.type = CommandType::checkpoint;
+    checkpoint.order_id = m_book.digest();
+    if (m_journal->append(checkpoint)) m_since_checkpoint = 0;
+}
+
+bool MatchingEngine::drain_once() {
+    bool did_work = false;
+    Command batch[MAX_BURST];
+    Result results[MAX_BURST];
+
+    // Пачку выделенного гейтвея применяем одним process_batch (по его seq)
+    int n = 0;
+    while (n < MAX_BURST && m_inbound.try_pop(batch[n])) ++n;
+    if (n) {
+        // process_batch применил бы пачку по seq — в том же порядке её пишем в
+        // журнал и публикуем ответы, чтобы реплика повторила его буквально
+        // Вставками: пачка не длиннее MAX_BURST, равные seq не переставляются,
+        // и без буфера в куче, который взял бы stable_sort
+        for (int i = 1; i < n; ++i) {
+            Command cmd = batch[i];
+            int j = i;
+            for (; j > 0 && batch[j - 1].seq > cmd.seq; --j) batch[j] = batch[j - 1];
+            batch[j] = cmd;
+        }
+        // Сначала в журнал; журнал полон — хвост пачки отклоняется, не исполняясь
+        int logged = 0;
+        while (logged < n && journal(batch[logged])) ++logged;
+        m_book.process_batch({batch, static_cast<size_t>(logged)}, {results, static_cast<size_t>(logged)});
+        for (int i = logged; i < n; ++i) results[i] = Result{batch[i].seq};
+        for (int i = 0; i < n; ++i) publish(results[i]);
+        maybe_checkpoint(logged);
+        did_work = true;
+    }
+
+    // У разных гейтвеев свои seq — общее кольцо исполняем строго по прибытию
+    for (int i = 0; i < MAX_BURST && m_shared_inbound.try_pop(batch[0]); ++i) {
+        if (journal(batch[0])) {
+            publish(m_book.execute(batch[0]));
+            maybe_checkpoint(1);
+        } else {
+            publish(Result{batch[0].seq});
+        }
+        did_work = true;
+    }
+    return did_work;
+}
+
+void MatchingEngine::run(int cpu) {
+    pin_current_thread(cpu);
+    // Прогретая книга дальше кучу не трогает; с -DORDERBOOK_ALLOC_GUARD это проверяется
+    std::optional<AllocationGuard> guard;
+    if (m_book.warmed_up()) guard.emplace();
+
+    int idle = 0;
+    while (m_running.load(std::memory_order_relaxed)) {
+        if (drain_once()) {
+            idle = 0;
+        } else if (!m_journal && m_book.compact(IDLE_COMPACT_LEVELS)) {
+            // Простой уходит на уплотнение уровней. С журналом — нет: момент
+            // простоя в журнал не попадает, а освобождённые слоты меняют ID
+            // следующих ордеров, и реплика бы разошлась
+            idle = 0;
+        } else if (++idle >= IDLE_SPINS_BEFORE_YIELD) {
+            std::this_thread::yield();
+            idle = 0;
+        } else {
+            cpu_relax();
+        }
+    }
+
+    // Всё, что было принято до stop(), должно быть исполнено
+    while (drain_once()) {}
+}
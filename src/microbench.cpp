@@ -0,0 +1,237 @@
+/**
+ * @file microbench.cpp
+ * @brief Parameterized microbenchmarks with per-op hardware counters (`make bench`).
+ *
+ * Every case runs against a background book of each depth in DEPTHS and
+ * reports, per operation: wall time (TSC), cycles, instructions, LLC misses
+ * and dTLB load misses. Book maintenance between batches (refilling swept
+ * levels, cancelling what the batch added) is outside the measured region.
+ * Without perf_event_open access the counter columns show "-".
+ *
+ * Usage: ./microbench [filter]   — only cases whose name contains `filter`
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "../include/orderbook.hpp"
+#include "../include/perf_counters.hpp"
+#include "../include/tsc_clock.hpp"
+
+namespace {
+
+const size_t DEPTHS[] = {1'000, 100'000};
+const int32_t MID = 10000;
+
+// Фоновая книга: depth ордеров на 100 уровнях с каждой стороны от MID
+void fill_book(Orderbook& book, size_t depth, bool asks = true) {
+    std::mt19937 rng(7);
+    for (size_t i = 0; i < depth; ++i) {
+        int32_t offset = 1 + static_cast<int32_t>(rng() % 100);
+        if (asks && (i & 1)) book.add_order(10, MID + offset, BookSide::ask);
+        else book.add_order(10, MID - offset, BookSide::bid);
+    }
+}
+
+class Bench {
+public:
+    explicit Bench(const char* filter) : m_filter(filter) {
+        std::printf("%-16s %7s %8s %9s %9s %9s %9s %9s\n", "case", "param", "depth", "ns/op", "cycles",
+                    "instr", "LLC-miss", "dTLB-miss");
+        if (!m_pmu.available()) std::printf("(perf_event_open unavailable: wall time only)\n");
+    }
+
+    bool enabled(const char* name) const { return !m_filter || std::strstr(name, m_filter); }
+
+    // setup(batch) — вне замера; затем ops вызовов op(i) под счётчиками
+    template <typename Setup, typename Op>
+    void run(const char* name, size_t param, size_t depth, size_t batches, size_t ops, Setup&& setup, Op&& op) {
+        uint64_t ticks = 0;
+        uint64_t totals[PerfCounters::EVENT_COUNT] = {};
+        bool valid[PerfCounters::EVENT_COUNT] = {};
+        for (size_t b = 0; b < batches; ++b) {
+            setup(b);
+            m_pmu.start();
+            uint64_t t0 = tsc_now();
+            for (size_t i = 0; i < ops; ++i) op(i);
+            uint64_t t1 = tsc_now();
+            m_pmu.stop();
+            ticks += t1 - t0;
+            PerfCounters::Reading r = m_pmu.read();
+            for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+                totals[e] += r.value[e];
+                valid[e] = r.valid[e];
+            }
+        }
+
+        double n = static_cast<double>(batches * ops);
+        std::printf("%-16s %7zu %8zu %9.1f", name, param, depth, ticks * TscClock::ns_per_tick() / n);
+        for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+            if (valid[e]) std::printf(" %9.2f", totals[e] / n);
+            else std::printf(" %9s", "-");
+        }
+        std::printf("\n");
+    }
+
+private:
+    const char* m_filter;
+    PerfCounters m_pmu;
+};
+
+void bench_add(Bench& bench, size_t depth, bool deep) {
+    const char* name = deep ? "add_deep" : "add_touch";
+    if (!bench.enabled(name)) return;
+    Orderbook book(false);
+    fill_book(book, depth);
+    // ID кладём в заранее выделенный слот: под замером — одна запись, без push_back
+    const size_t OPS = 1000;
+    std::vector<uint64_t> added(OPS, 0);
+    bench.run(name, 0, depth, 50, OPS,
+              [&](size_t) {
+                  for (uint64_t& id : added) {
+                      if (id) book.delete_order(id);
+                      id = 0;
+                  }
+              },
+              [&](size_t i) {
+                  // У касания — лучший bid; вглубь — новые уровни далеко под книгой
+                  int32_t price = deep ? MID - 500 - static_cast<int32_t>(i % 500) : MID - 1;
+                  added[i] = book.add_order(10, price, BookSide::bid);
+              });
+}
+
+void bench_cancel(Bench& bench, size_t depth, const char* name, size_t level_size,
+                  CancelPolicy policy = CancelPolicy::unlink) {
+    if (!bench.enabled(name)) return;
+    BookConfig config;
+    config.cancel_policy = policy;
+    Orderbook book(config);
+    fill_book(book, depth);
+    const int32_t price = MID - 200; // свой уровень, вне фоновой книги
+    std::vector<uint64_t> ids(level_size);
+    std::vector<uint64_t> order(level_size / 2);
+    const size_t OPS = level_size / 2;
+
+    bool front = std::strstr(name, "front"), back = std::strstr(name, "back");
+    bench.run(name, level_size, depth, 20, OPS,
+              [&](size_t b) {
+                  if (b > 0) {
+                      for (uint64_t id : ids) book.delete_order(id); // остаток прошлой пачки
+                  }
+                  for (uint64_t& id : ids) id = book.add_order(10, price, BookSide::bid);
+                  size_t mid = level_size / 2;
+                  for (size_t i = 0; i < OPS; ++i) {
+                      if (front) order[i] = ids[i];
+                      else if (back) order[i] = ids[level_size - 1 - i];
+                      else order[i] = ids[(i & 1) ? mid + (i + 1) / 2 : mid - i / 2]; // от середины наружу
+                  }
+              },
+              [&](size_t i) { book.delete_order(order[i]); });
+}
+
+void bench_sweep(Bench& bench, size_t depth, size_t levels) {
+    const char* name = "market_sweep";
+    if (!bench.enabled(name)) return;
+    Orderbook book(false);
+    fill_book(book, depth, false); // фон — только bid, ask строим сами
+    const int ORDERS_PER_LEVEL = 10;
+    auto refill = [&] {
+        for (size_t l = 0; l < levels; ++l) {
+            for (int k = 0; k < ORDERS_PER_LEVEL; ++k) book.add_order(10, MID + 1 + static_cast<int32_t>(l), BookSide::ask);
+        }
+    };
+    bench.run(name, levels, depth, 200, 1,
+              [&](size_t) { refill(); },
+              [&](size_t) { book.handle_order(OrderType::market, static_cast<int>(levels) * ORDERS_PER_LEVEL * 10, Side::buy); });
+}
+
+void bench_modify(Bench& bench, size_t depth) {
+    if (!bench.enabled("modify")) return;
+    Orderbook book(false);
+    std::vector<uint64_t> ids;
+    std::mt19937 rng(11);
+    for (size_t i = 0; i < depth; ++i) ids.push_back(book.add_order(10, MID - 1 - static_cast<int32_t>(rng() % 100), BookSide::bid));
+    std::shuffle(ids.begin(), ids.end(), rng);
+    const size_t OPS = 10000;
+    bench.run("modify", 0, depth, 20, OPS, [](size_t) {},
+              [&](size_t i) { book.modify_order(ids[i % ids.size()], 5 + static_cast<int>(i & 7)); });
+}
+
+// Перенос ордера на соседний уровень глубже касания: тот же слот, без release/acquire
+void bench_replace(Bench& bench, size_t depth) {
+    if (!bench.enabled("replace")) return;
+    Orderbook book(false);
+    std::vector<uint64_t> ids;
+    std::mt19937 rng(13);
+    for (size_t i = 0; i < depth; ++i) ids.push_back(book.add_order(10, MID - 2 - static_cast<int32_t>(rng() % 99), BookSide::bid));
+    std::shuffle(ids.begin(), ids.end(), rng);
+    const size_t OPS = 10000;
+    bench.run("replace", 0, depth, 20, OPS, [](size_t) {},
+              [&](size_t i) { book.replace_order(ids[i % ids.size()], 10, MID - 2 - static_cast<int32_t>(i % 99)); });
+}
+
+// Обрыв сессии: session ордеров владельца 1 вперемешку с фоном, снимаются одним cancel_all(owner)
+void bench_cancel_owner(Bench& bench, size_t depth, size_t session) {
+    const char* name = "cancel_owner";
+    if (!bench.enabled(name)) return;
+    BookConfig config;
+    config.pool_capacity = depth + session;
+    Orderbook book(config);
+    fill_book(book, depth);
+    std::mt19937 rng(17);
+    bench.run(name, session, depth, 10, 1,
+              [&](size_t) {
+                  for (size_t i = 0; i < session; ++i) {
+                      int32_t offset = 1 + static_cast<int32_t>(rng() % 100);
+                      if (i & 1) book.add_order(10, MID + offset, BookSide::ask, 1);
+                      else book.add_order(10, MID - offset, BookSide::bid, 1);
+                  }
+              },
+              [&](size_t) { book.cancel_all(1); });
+}
+
+void bench_best_quote(Bench& bench, size_t depth) {
+    if (!bench.enabled("best_quote")) return;
+    Orderbook book(false);
+    fill_book(book, depth);
+    volatile int sink = 0;
+    bench.run("best_quote", 0, depth, 20, 100000, [](size_t) {},
+              [&](size_t i) { sink = book.best_quote((i & 1) ? BookSide::ask : BookSide::bid); });
+    (void)sink;
+}
+
+// Стоимость прохода по levels уровням без исполнения: оценка FOK / предторговая проверка
+void bench_estimate(Bench& bench, size_t depth, size_t levels) {
+    const char* name = "estimate_sweep";
+    if (!bench.enabled(name)) return;
+    Orderbook book(false);
+    fill_book(book, depth, false);
+    for (size_t l = 0; l < levels; ++l) book.add_order(100, MID + 1 + static_cast<int32_t>(l), BookSide::ask);
+    volatile int64_t sink = 0;
+    bench.run(name, levels, depth, 20, 10000, [](size_t) {},
+              [&](size_t) { sink = book.estimate_sweep(Side::buy, static_cast<int64_t>(levels) * 100).notional; });
+    (void)sink;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Bench bench(argc > 1 ? argv[1] : nullptr);
+    for (size_t depth : DEPTHS) {
+        bench_add(bench, depth, false);
+        bench_add(bench, depth, true);
+        bench_cancel(bench, depth, "cancel_front", 2000);
+        bench_cancel(bench, depth, "cancel_middle", 2000);
+        bench_cancel(bench, depth, "cancel_back", 2000);
+        bench_cancel(bench, depth, "cancel_mid_tomb", 2000, CancelPolicy::tombstone);
+        for (size_t levels : {1, 10, 100}) bench_sweep(bench, depth, levels);
+        bench_modify(bench, depth);
+        bench_replace(bench, depth);
+        bench_cancel_owner(bench, depth, 50'000);
+        bench_best_quote(bench, depth);
+        for (size_t levels : {10, 100}) bench_estimate(bench, depth, levels);
+    }
+    return 0;
+}
@@ -3,187 +3,371 @@
  * @brief This file contains the implementation of the Orderbook class.
  */
 
+#include <algorithm>
 #include <iostream>
-#include <chrono>
-#include <stdlib.h>
 #include <map>
-#include <thread>
 #include <iomanip>
-#include <memory>
-#include <deque>
+#include <random>
+#include <stdexcept>
 
+#include "../include/depth_scan.hpp"
 #include "../include/order.hpp"
 #include "../include/orderbook.hpp"
 
 using namespace std;
 
-void Orderbook::add_order(int qty, int32_t price_cents, BookSide side) {
-    if (price_cents < MIN_PRICE_CENTS || price_cents > MAX_PRICE_CENTS) return;
-
-    Order* order = m_order_pool.acquire(qty, price_cents);
+Order* Orderbook::acquire_order(int qty, int32_t price_cents, BookSide side, uint32_t owner) {
+    Order* order = m_order_pool.acquire(qty, price_cents, side);
     // if (!order) return; // пул исчерпан
 
     if (!order) {
         // Лучше бросить исключение или залогировать
         throw std::runtime_error("Order pool exhausted");
     }
+    order->owner = owner;
+    return order;
+}
 
-    uint64_t order_id = order->id;
-    size_t idx = price_cents - MIN_PRICE_CENTS;
-
-    if (side == BookSide::bid) {
-        if (m_bids.empty()) {
-            m_bids.reserve(64); 
-        }
-        m_bids[idx].push_back(order);
-        m_active_bids.insert(price_cents);
-        if (price_cents > m_best_bid) m_best_bid = price_cents;
-    } else {
-        if (m_asks.empty()) {
-            m_asks.reserve(64); 
-        }
-        m_asks[idx].push_back(order);
-        m_active_asks.insert(price_cents);
-        if (price_cents < m_best_ask) m_best_ask = price_cents;
+// Ставит уже взятый из пула ордер в хвост его уровня; у айсберга (display > 0)
+// видна только первая часть, остальное уходит в резерв. orders_added и список
+// владельца ведут вызывающие: replace_order переставляет уже стоявший ордер
+template <typename Sink>
+void Orderbook::rest_order(Order* order, Sink& sink) {
+    uint32_t slot = m_order_pool.index_of(order);
+    size_t t = price_index(order->price_cents);
+    PriceLadder& ladder = (order->side == BookSide::bid) ? m_bids : m_asks;
+    PriceLevel& level = ladder.level(t);
+
+    int& quantity = m_order_pool.quantity(slot);
+    fold_level(order->side, t, level);
+    if (order->display > 0 && quantity > order->display) {
+        order->reserve = quantity - order->display;
+        quantity = order->display;
+        level.reserve += order->reserve;
     }
+    level.push_back(m_order_pool, slot);
+    fold_level(order->side, t, level);
+    ladder.mark_active(t);
+    m_stats.raise(BookCounters::max_fifo_depth, level.count);
+    mark_dirty(order->side, t, level);
+    if (ladder.windowed()) maybe_recenter(order->side);
+
+    sink.on_event({order->id, 0, order->price_cents, m_order_pool.quantity(slot), EventType::rest, order->side});
+}
+
+void Orderbook::maybe_recenter(BookSide side) {
+    PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    if (!ladder.windowed()) return;
+
+    size_t best = (side == BookSide::bid) ? ladder.last() : ladder.first();
+    if (best == PriceLadder::npos) return;
+
+    // Касание держим внутри окна с запасом в 1/8 ширины с каждого края
+    size_t width = ladder.window_width();
+    size_t lo = ladder.window_lo();
+    size_t margin = width / 8;
+    if (best >= lo + margin && best < lo + width - margin) return;
 
-    m_order_metadata[order_id] = std::make_pair(side, price_cents);
+    // Глубина лежит за касанием: у bid — ниже, у ask — выше
+    size_t offset = (side == BookSide::bid) ? width - width / 4 : width / 4;
+    ladder.recenter(best > offset ? best - offset : 0);
 }
 
+template <typename Sink>
+uint64_t Orderbook::add_order(int qty, int32_t price_cents, BookSide side, uint32_t owner, Sink& sink) {
+    if (qty <= 0 || !in_band(price_cents)) return 0;
+
+    Order* order = acquire_order(qty, price_cents, side, owner);
+    m_stats.add(BookCounters::orders_added);
+    link_owner(m_order_pool.index_of(order));
+    rest_order(order, sink);
+    return order->id;
+}
+
+
+// Проверка до построения лестниц: они сразу выделяют уровни под весь диапазон
+static const BookConfig& validated(const BookConfig& config) {
+    if (config.tick_size <= 0 || config.min_price_cents > config.max_price_cents ||
+        (config.max_pool_capacity && config.max_pool_capacity < config.pool_capacity) ||
+        PriceLadder::width(config.level_count(), config.window_ticks) > PriceBitmap::MAX_BITS) {
+        throw std::invalid_argument("Invalid book config");
+    }
+    return config;
+}
+
+Orderbook::Orderbook(const BookConfig& config, std::pmr::memory_resource* mr)
+    : m_config(validated(config)),
+      m_bids(config.level_count(), config.window_ticks, mr),
+      m_asks(config.level_count(), config.window_ticks, mr),
+      m_order_pool(config.pool_capacity, mr, config.max_pool_capacity) {}
 
 Orderbook::Orderbook(bool generate_dummies)
-    : m_bids(MAX_PRICE_CENTS + 1), m_asks(MAX_PRICE_CENTS + 1)
+    : Orderbook(BookConfig{})
 {
-    srand(12);
-
     if (generate_dummies) {
+        // Свой генератор с фиксированным зерном: книга с заглушками каждый раз
+        // одна и та же (тот же порядок, те же ID), без глобального rand и пауз
+        minstd_rand rng(12);
+
         // Dummy bids: $90.00 – $100.00 → 9000–10000 центов
         for (int i = 0; i < 3; i++) {
-            int random_price_cents = 9000 + (rand() % 1001);
-            int random_qty = rand() % 100 + 1;
-            int random_qty2 = rand() % 100 + 1;
-            
+            int random_price_cents = 9000 + static_cast<int>(rng() % 1001);
+            int random_qty = static_cast<int>(rng() % 100) + 1;
+            int random_qty2 = static_cast<int>(rng() % 100) + 1;
+
             add_order(random_qty, random_price_cents, BookSide::bid);
-            this_thread::sleep_for(chrono::milliseconds(1));
             add_order(random_qty2, random_price_cents, BookSide::bid);
         }
 
         // Dummy asks: $100.00 – $110.00 → 10000–11000 центов
         for (int i = 0; i < 3; i++) {
-            int random_price_cents = 10000 + (rand() % 1001);
-            int random_qty = rand() % 100 + 1;
-            int random_qty2 = rand() % 100 + 1;
-            
+            int random_price_cents = 10000 + static_cast<int>(rng() % 1001);
+            int random_qty = static_cast<int>(rng() % 100) + 1;
+            int random_qty2 = static_cast<int>(rng() % 100) + 1;
+
             add_order(random_qty, random_price_cents, BookSide::ask);
-            this_thread::sleep_for(chrono::milliseconds(1));
             add_order(random_qty2, random_price_cents, BookSide::ask);
         }
     }
 }
 
-// Template function to fill orders from the offers (deque) at each price level
-template <typename T>
-std::pair<int, double> Orderbook::fill_order(map<double, deque<unique_ptr<Order>>, T>& offers, 
-                                               const OrderType type, const Side side, int& order_quantity,
-                                               const int32_t price, int& units_transacted, double& total_value) {
-    // Iterate over the price levels (best prices first)
-    auto rit = offers.begin();
-    while(rit != offers.end()) {
-        const double price_level = rit->first;
-        auto& orders = rit->second;
-
-        // For a limit order, ensure the price level is acceptable
-        // market order always acceptable price
-        bool can_transact = true;
-        if (type == OrderType::limit) {
-            if (side == Side::buy && price_level > price) {
-                can_transact = false;
-            } else if (side == Side::sell && price_level < price) {
-                can_transact = false;
-            }
+bool Orderbook::warm_up(const WarmupProfile& profile) {
+    int32_t reference = profile.reference_price_cents
+                            ? std::clamp(profile.reference_price_cents, m_config.min_price_cents, m_config.max_price_cents)
+                            : m_config.min_price_cents + (m_config.max_price_cents - m_config.min_price_cents) / 2;
+    size_t mid = price_index(reference);
+    size_t lo = mid > profile.levels_per_side ? mid - profile.levels_per_side : 0;
+    size_t hi = std::min(mid + profile.levels_per_side, m_config.level_count() - 1);
+
+    for (BookSide side : {BookSide::bid, BookSide::ask}) {
+        PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+        if (ladder.windowed()) {
+            // Как в maybe_recenter: глубина за касанием
+            size_t width = ladder.window_width();
+            size_t offset = (side == BookSide::bid) ? width - width / 4 : width / 4;
+            ladder.recenter(mid > offset ? mid - offset : 0);
+        }
+        // Заголовки у середины — в кэш и TLB; запись того же байта, состояние не меняется
+        for (size_t t = lo; t <= hi; ++t) {
+            if (!ladder.in_window(t)) continue;
+            volatile bool* flag = &ladder.find(t)->dirty;
+            *flag = *flag;
         }
+    }
 
-        if (can_transact) {
-            // Process orders at this price level while there are orders and the incoming order is not fully filled
-            while (!orders.empty() && order_quantity > 0) {
-                auto& current_order = orders.front();
-                const u_int64_t order_id = current_order->id;
-                int current_qty = current_order->quantity;
-                double current_price = current_order->price;
-
-                if (current_qty > order_quantity) { // Partial fill
-                    units_transacted += order_quantity;
-                    total_value += order_quantity * current_price;
-                    current_order->quantity = current_qty - order_quantity;
-                    order_quantity = 0;
-                    break; // Incoming order fully filled
-                } else { // Full fill
-                    units_transacted += current_qty;
-                    total_value += current_qty * current_price;
-                    order_quantity -= current_qty;
-                    orders.pop_front();
-                    // clean cache
-                    m_order_metadata.erase(order_id);
-                }
-            }
-            
-            // remove map entry if we wiped all the orders 
-            if (orders.empty()){
-                rit = offers.erase(rit);
-            }else{
-                if (order_quantity > 0) ++rit;
-                else break;
+    size_t levels = hi - lo + 1;
+    m_dirty_bids.reserve(levels);
+    m_dirty_asks.reserve(levels);
+    m_compact_bids.reserve(levels);
+    m_compact_asks.reserve(levels);
+    m_batch_order.reserve(profile.max_batch);
+    m_owners.reserve(size_t{profile.expected_owners} + 1);
+    m_warmed = true;
+    return m_order_pool.reserve(profile.expected_orders);
+}
+
+// Сколько уровней окна суммируется одним вызовом scan_levels: дальше пустоты
+// перепрыгиваем по битовой карте, а не читаем заголовок за заголовком
+static const size_t SWEEP_SCAN_LEVELS = 64;
+
+template <Side S, OrderType T>
+SweepEstimate Orderbook::sweep(int64_t cap, int32_t limit_price) const {
+    constexpr bool descending = S == Side::sell; // продажа идёт по bid сверху вниз
+    const PriceLadder& ladder = (S == Side::buy) ? m_asks : m_bids;
+    SweepEstimate estimate;
+    if (cap <= 0) return estimate;
+
+    // Последний тик в пределах лимита
+    size_t bound = descending ? 0 : m_config.level_count() - 1;
+    if constexpr (T == OrderType::limit) {
+        if (descending ? limit_price > m_config.max_price_cents : limit_price < m_config.min_price_cents) return estimate;
+        int32_t offset = limit_price - m_config.min_price_cents;
+        if (descending) bound = offset <= 0 ? 0 : static_cast<size_t>((offset + m_config.tick_size - 1) / m_config.tick_size);
+        else bound = std::min(static_cast<size_t>(offset / m_config.tick_size), bound);
+    }
+
+    size_t t = descending ? ladder.last() : ladder.first();
+    size_t reached = PriceLadder::npos; // дальний тик, до которого дошли
+    while (t != PriceLadder::npos && estimate.quantity < cap && (descending ? t >= bound : t <= bound)) {
+        int64_t price_cents = index_price(t);
+        int64_t remaining = cap - estimate.quantity;
+
+        const PriceLevel* run_start = nullptr;
+        size_t run = std::min({ladder.contiguous(t, descending, run_start), SWEEP_SCAN_LEVELS,
+                               (descending ? t - bound : bound - t) + 1});
+        const PriceLevel* partial = nullptr;
+        if (run) {
+            LevelScan scan = scan_levels(run_start, run, descending, remaining);
+            estimate.quantity += scan.quantity;
+            estimate.notional += price_cents * scan.quantity +
+                                 (descending ? -1 : 1) * int64_t{m_config.tick_size} * scan.weighted;
+            if (scan.levels < run) {
+                partial = run_start + (descending ? -1 : 1) * static_cast<ptrdiff_t>(scan.levels);
+                t = descending ? t - scan.levels : t + scan.levels;
+                price_cents = index_price(t);
+            } else {
+                t = descending ? t - (run - 1) : t + (run - 1);
             }
-        }else{
-            // Prices will only get worse, break
-            break;
+        } else {
+            partial = ladder.find(t); // overflow вне окна — по одному уровню
         }
+
+        if (partial) {
+            // Этот уровень (или уровень overflow) берём сколько нужно
+            int64_t take = std::min(partial->quantity + partial->reserve, cap - estimate.quantity);
+            estimate.quantity += take;
+            estimate.notional += take * price_cents;
+        }
+        reached = t;
+        if constexpr (descending) t = t ? ladder.prev(t - 1) : PriceLadder::npos;
+        else t = ladder.next(t + 1);
     }
-    
-    return std::make_pair(units_transacted, total_value);
+
+    // Худшая задетая цена — ближайший занятый уровень не дальше достигнутого
+    if (estimate.quantity > 0) {
+        estimate.last_price_cents = index_price(descending ? ladder.next(reached) : ladder.prev(reached));
+    }
+    return estimate;
+}
+
+SweepEstimate Orderbook::estimate_sweep(Side side, int64_t qty) const {
+    return side == Side::buy ? sweep<Side::buy, OrderType::market>(qty, 0)
+                             : sweep<Side::sell, OrderType::market>(qty, 0);
+}
+
+SweepEstimate Orderbook::estimate_sweep(Side side, int64_t qty, int32_t limit_price) const {
+    return side == Side::buy ? sweep<Side::buy, OrderType::limit>(qty, limit_price)
+                             : sweep<Side::sell, OrderType::limit>(qty, limit_price);
 }
 
 // Handles market and limit orders, returning the total units transacted and total value
-std::pair<int, double> Orderbook::handle_order(OrderType type, int order_quantity, Side side, int32_t price) {
+template <typename Sink>
+std::pair<int, int64_t> Orderbook::handle_order(OrderType type, int order_quantity, Side side, int32_t price,
+                                                TimeInForce tif, int display_qty, uint32_t owner, Sink& sink) {
     int units_transacted = 0;
-    double total_value = 0;
+    int64_t total_value = 0; // в центах (тиках), без округлений
+    BookSide rest_side = (side == Side::buy) ? BookSide::bid : BookSide::ask;
+
+    // Объём <= 0 не доходит до сопоставления: цикл match выходит только на нуле
+    if (order_quantity <= 0) {
+        m_stats.add(BookCounters::rejects);
+        sink.on_event({0, 0, price, order_quantity, EventType::reject, rest_side});
+        return {0, 0};
+    }
 
-    if (type == OrderType::market) {
-        if (side == Side::sell) {
-            // return fill_order(m_bids, OrderType::market, Side::sell, order_quantity, price, units_transacted, total_value);
-            return fill_bids(order_quantity, -1, units_transacted, total_value);
-        } else if (side == Side::buy) {
-            return fill_asks(order_quantity, -1, units_transacted, total_value);
-            // return fill_order(m_asks, OrderType::market, Side::buy, order_quantity, price, units_transacted, total_value);
+    // Отказы решаются до первого изменения книги: post-only не должен
+    // пересечь спред, FOK — найти весь объём в пределах лимита
+    if (tif == TimeInForce::post_only) {
+        int opposite = best_quote(side == Side::buy ? BookSide::ask : BookSide::bid);
+        bool crosses = type == OrderType::market ||
+                       (opposite != -1 && (side == Side::buy ? opposite <= price : opposite >= price));
+        if (crosses) {
+            m_stats.add(BookCounters::rejects);
+            sink.on_event({0, 0, price, order_quantity, EventType::reject, rest_side});
+            return {0, 0};
         }
-    } else if (type == OrderType::limit) {
-        if (side == Side::buy) {
-            int best_ask = m_active_asks.empty() ? -1 : m_best_ask;
-            if (best_ask != -1 && best_ask <= price) {
-                auto fill = fill_asks(order_quantity, price, units_transacted, total_value);
-                if (order_quantity > 0)
-                    add_order(order_quantity, price, BookSide::bid);
-                return fill;
-            } else {
-                add_order(order_quantity, price, BookSide::bid);
-                return {units_transacted, total_value};
-            }
-        } else { // Side::sell
-            int best_bid = m_active_bids.empty() ? -1 : m_best_bid;
-            if (best_bid != -1 && best_bid >= price) {
-                auto fill = fill_bids(order_quantity, price, units_transacted, total_value);
-                if (order_quantity > 0)
-                    add_order(order_quantity, price, BookSide::ask);
-                return fill;
-            } else {
-                add_order(order_quantity, price, BookSide::ask);
-                return {units_transacted, total_value};
-            }
+    } else if (tif == TimeInForce::fok) {
+        bool fills = (type == OrderType::market)
+            ? (side == Side::buy ? can_fill<Side::buy, OrderType::market>(order_quantity, 0)
+                                 : can_fill<Side::sell, OrderType::market>(order_quantity, 0))
+            : (side == Side::buy ? can_fill<Side::buy, OrderType::limit>(order_quantity, price)
+                                 : can_fill<Side::sell, OrderType::limit>(order_quantity, price));
+        if (!fills) {
+            m_stats.add(BookCounters::rejects);
+            sink.on_event({0, 0, price, order_quantity, EventType::reject, rest_side});
+            return {0, 0};
         }
-    } else {
+    }
+
+    // Тип и сторона разбираются один раз — дальше специализированное ядро
+    if (type == OrderType::market) {
+        if (side == Side::buy) match<Side::buy, OrderType::market>(order_quantity, 0, 0, units_transacted, total_value, sink);
+        else match<Side::sell, OrderType::market>(order_quantity, 0, 0, units_transacted, total_value, sink);
+        return {units_transacted, total_value};
+    } else if (type != OrderType::limit) {
         throw std::runtime_error("Invalid order type encountered");
     }
-    return std::make_pair(units_transacted, total_value);
+
+    // Слот берём до сопоставления, чтобы события исполнения уже несли ID
+    // лимитки; цена вне книги исполняется, но остаток не встаёт (как раньше).
+    // IOC/FOK никогда не встают — им слот не нужен, их taker_id равен 0
+    bool may_rest = tif == TimeInForce::gtc || tif == TimeInForce::post_only;
+    Order* taker = (may_rest && in_band(price)) ? acquire_order(order_quantity, price, rest_side, owner) : nullptr;
+    uint64_t taker_id = taker ? taker->id : 0;
+
+    // Не пересекающая спред лимитка останавливается на первой же проверке лимита
+    if (side == Side::buy) match<Side::buy, OrderType::limit>(order_quantity, price, taker_id, units_transacted, total_value, sink);
+    else match<Side::sell, OrderType::limit>(order_quantity, price, taker_id, units_transacted, total_value, sink);
+
+    if (taker) {
+        if (order_quantity > 0) {
+            m_order_pool.quantity(m_order_pool.index_of(taker)) = order_quantity;
+            taker->display = display_qty;
+            m_stats.add(BookCounters::orders_added);
+            link_owner(m_order_pool.index_of(taker));
+            rest_order(taker, sink);
+        } else {
+            m_order_pool.release(taker);
+        }
+    }
+    return {units_transacted, total_value};
+}
+
+Result Orderbook::execute(const Command& cmd) {
+    Result result;
+    result.seq = cmd.seq;
+
+    // Запоминает только ID вставшего остатка и отказ — остальное выбрасывается
+    struct RestedIdSink {
+        uint64_t id = 0;
+        bool rejected = false;
+        void on_event(const ExecEvent& event) {
+            if (event.type == EventType::rest) id = event.maker_id;
+            else if (event.type == EventType::reject) rejected = true;
+        }
+    } sink;
+
+    // Команда сессии по ID — только над её собственным ордером
+    if (cmd.owner && (cmd.type == CommandType::modify || cmd.type == CommandType::cancel ||
+                      cmd.type == CommandType::replace) && !owned_by(cmd.order_id, cmd.owner)) {
+        return result;
+    }
+
+    switch (cmd.type) {
+    case CommandType::order: {
+        auto [units, value] = handle_order(cmd.order_type, cmd.quantity, cmd.side, cmd.price_cents,
+                                           cmd.tif, cmd.display_quantity, cmd.owner, sink);
+        result.units_transacted = units;
+        result.total_value = value;
+        result.order_id = sink.id;
+        result.ok = !sink.rejected;
+        break;
+    }
+    case CommandType::modify:
+        result.ok = modify_order(cmd.order_id, cmd.quantity);
+        break;
+    case CommandType::cancel:
+        result.ok = delete_order(cmd.order_id);
+        break;
+    case CommandType::replace:
+        result.ok = replace_order(cmd.order_id, cmd.quantity, cmd.price_cents,
+                                  result.units_transacted, result.total_value, sink);
+        if (result.ok && m_order_pool.find(cmd.order_id)) result.order_id = cmd.order_id;
+        break;
+    case CommandType::mass_cancel: {
+        for (BookSide side : {BookSide::bid, BookSide::ask}) {
+            if (!cmd.both_sides && side != (cmd.side == Side::buy ? BookSide::bid : BookSide::ask)) continue;
+            if (cmd.owner) cancel_all(cmd.owner, side);
+            else cancel_all(side);
+        }
+        result.ok = true;
+        break;
+    }
+    case CommandType::checkpoint:
+        result.ok = cmd.order_id == m_digest;
+        break;
+    }
+    return result;
 }
 
 // Returns the best quote (price) for the given book side
@@ -197,94 +381,345 @@ std::pair<int, double> Orderbook::handle_order(OrderType type, int order_quantit
 //     }
 // }
 
-int Orderbook::best_quote(BookSide side) {
-    if (side == BookSide::bid) {
-        for (int p = MAX_PRICE_CENTS; p >= MIN_PRICE_CENTS; --p) {
-            if (!m_bids[p - MIN_PRICE_CENTS].empty()) {
-                return p;
-            }
+// Сколько команд вперёд подтягиваем уровни и слоты пула
+static const size_t BATCH_PREFETCH_DISTANCE = 4;
+
+void Orderbook::prefetch_command(const Command& cmd) {
+    switch (cmd.type) {
+    case CommandType::order:
+        // Лимитка встанет (или начнёт сопоставление) на своём уровне
+        if (cmd.order_type == OrderType::limit && in_band(cmd.price_cents)) {
+            size_t t = price_index(cmd.price_cents);
+            (cmd.side == Side::buy ? m_bids : m_asks).prefetch(t);
         }
-    } else if (side == BookSide::ask) {
-        for (int p = MIN_PRICE_CENTS; p <= MAX_PRICE_CENTS; ++p) {
-            if (!m_asks[p - MIN_PRICE_CENTS].empty()) {
-                return p;
-            }
+        break;
+    case CommandType::modify:
+    case CommandType::cancel:
+    case CommandType::replace:
+        m_order_pool.prefetch(order_id_slot(cmd.order_id));
+        break;
+    case CommandType::mass_cancel:
+    case CommandType::checkpoint:
+        break;
+    }
+}
+
+size_t Orderbook::process_batch(std::span<const Command> commands, std::span<Result> results) {
+    size_t n = std::min(commands.size(), results.size());
+
+    bool ordered = true;
+    for (size_t i = 1; i < n && ordered; ++i) {
+        ordered = commands[i - 1].seq <= commands[i].seq;
+    }
+
+    if (ordered) return apply_in_order(commands, results);
+
+    // Гейтвей прислал пакет не по порядку — применяем по seq, отвечаем по позиции
+    m_batch_order.resize(n);
+    for (size_t i = 0; i < n; ++i) m_batch_order[i] = static_cast<uint32_t>(i);
+    // Равные seq — по позиции: тот же порядок, что у stable_sort, но без его буфера в куче
+    std::sort(m_batch_order.begin(), m_batch_order.end(), [&](uint32_t a, uint32_t b) {
+        return commands[a].seq != commands[b].seq ? commands[a].seq < commands[b].seq : a < b;
+    });
+    for (size_t i = 0; i < n; ++i) {
+        if (i + BATCH_PREFETCH_DISTANCE < n) prefetch_command(commands[m_batch_order[i + BATCH_PREFETCH_DISTANCE]]);
+        uint32_t k = m_batch_order[i];
+        results[k] = execute(commands[k]);
+    }
+    return n;
+}
+
+size_t Orderbook::apply_in_order(std::span<const Command> commands, std::span<Result> results) {
+    size_t n = std::min(commands.size(), results.size());
+    for (size_t i = 0; i < n; ++i) {
+        if (i + BATCH_PREFETCH_DISTANCE < n) prefetch_command(commands[i + BATCH_PREFETCH_DISTANCE]);
+        results[i] = execute(commands[i]);
+    }
+    return n;
+}
+
+uint64_t Orderbook::full_digest() const {
+    uint64_t digest = 0;
+    for (BookSide side : {BookSide::bid, BookSide::ask}) {
+        const PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+        for (size_t t = ladder.first(); t != PriceLadder::npos; t = ladder.next(t + 1)) {
+            digest ^= level_hash(side, t, *ladder.find(t));
         }
     }
-    return -1; // нет ордеров
+    return digest;
 }
 
-// Search through whole book and modify the target order
-bool Orderbook::modify_order(uint64_t id, int new_qty) {
-    auto it = m_order_metadata.find(id);
-    if (it == m_order_metadata.end()) return false;
+int Orderbook::best_quote(BookSide side) {
+    size_t t = (side == BookSide::bid) ? m_bids.last() : m_asks.first();
+    if (t == PriceLadder::npos) return -1; // нет ордеров
+    return index_price(t);
+}
 
-    auto [side, price_cents] = it->second;
-    size_t idx = price_cents - MIN_PRICE_CENTS;
-    auto& levels = (side == BookSide::bid) ? m_bids : m_asks;
+size_t Orderbook::top_n(BookSide side, size_t n, std::span<DepthLevel> out) const {
+    const PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    n = std::min(n, out.size());
+
+    size_t written = 0;
+    size_t t = (side == BookSide::bid) ? ladder.last() : ladder.first();
+    while (t != PriceLadder::npos && written < n) {
+        const PriceLevel& level = *ladder.find(t);
+        out[written++] = {index_price(t), level.count, level.quantity};
+        if (side == BookSide::bid) t = t ? ladder.prev(t - 1) : PriceLadder::npos;
+        else t = ladder.next(t + 1);
+    }
+    return written;
+}
 
-    for (auto& order : levels[idx]) {
-        if (order->id == id) {
-            order->quantity = new_qty;
-            return true;
+void Orderbook::publish_side(BookSide side, std::vector<LevelUpdate>& out) {
+    PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    std::vector<size_t>& dirty = (side == BookSide::bid) ? m_dirty_bids : m_dirty_asks;
+
+    // Опустевший overflow-уровень стирается вместе с флагом, поэтому тик может
+    // попасть в список дважды
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    for (size_t t : dirty) {
+        PriceLevel* level = ladder.find(t);
+        if (level) {
+            level->dirty = false;
+            out.push_back({side, index_price(t), level->count, level->quantity});
+        } else {
+            out.push_back({side, index_price(t), 0, 0});
         }
     }
-    return false;
+    dirty.clear();
 }
 
-bool Orderbook::delete_order(uint64_t id) {
-    auto it = m_order_metadata.find(id);
-    if (it == m_order_metadata.end()) return false;
+size_t Orderbook::publish_depth(std::vector<LevelUpdate>& out) {
+    out.clear();
+    publish_side(BookSide::bid, out);
+    publish_side(BookSide::ask, out);
+    return out.size();
+}
 
-    auto [side, price_cents] = it->second;
-    m_order_metadata.erase(it);
+// Modify the target order in place; it keeps its queue position
+template <typename Sink>
+bool Orderbook::modify_order(uint64_t id, int new_qty, Sink& sink) {
+    Order* order = m_order_pool.find(id);
+    if (!order || new_qty <= 0) return false;
+
+    auto& ladder = (order->side == BookSide::bid) ? m_bids : m_asks;
+    size_t t = price_index(order->price_cents);
+    PriceLevel& level = *ladder.find(t);
+    int& quantity = m_order_pool.quantity(order_id_slot(id));
+    // Новый размер — весь (видимая часть + резерв). У айсберга видимая часть
+    // не растёт, прибавка уходит в резерв; уменьшение съедает резерв первым
+    int visible = order->display > 0 ? std::min(quantity, new_qty) : new_qty;
+    fold_level(order->side, t, level);
+    level.quantity += visible - quantity;
+    level.reserve += (new_qty - visible) - order->reserve;
+    quantity = visible;
+    order->reserve = new_qty - visible;
+    fold_level(order->side, t, level);
+    mark_dirty(order->side, t, level);
+    sink.on_event({id, 0, order->price_cents, new_qty, EventType::modify, order->side});
+    return true;
+}
 
-    size_t idx = price_cents - MIN_PRICE_CENTS;
-    auto& levels = (side == BookSide::bid) ? m_bids : m_asks;
-    auto& orders = levels[idx];
+template <typename Sink>
+bool Orderbook::replace_order(uint64_t id, int new_qty, int32_t new_price, int& units_transacted,
+                              int64_t& total_value, Sink& sink) {
+    Order* order = m_order_pool.find(id);
+    if (!order || new_qty <= 0 || !in_band(new_price)) return false;
+
+    BookSide side = order->side;
+    uint32_t slot = order_id_slot(id);
+    auto& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    size_t t = price_index(order->price_cents);
+    PriceLevel& level = *ladder.find(t);
+    int& quantity = m_order_pool.quantity(slot);
+    sink.on_event({id, 0, new_price, new_qty, EventType::modify, side});
+    fold_level(side, t, level);
+
+    if (new_price == order->price_cents && new_qty <= quantity + order->reserve) {
+        // Только уменьшение — место в очереди сохраняется; резерв айсберга уходит первым
+        int visible = std::min(quantity, new_qty);
+        level.quantity += visible - quantity;
+        level.reserve += (new_qty - visible) - order->reserve;
+        quantity = visible;
+        order->reserve = new_qty - visible;
+        fold_level(side, t, level);
+        mark_dirty(side, t, level);
+        return true;
+    }
 
-    for (auto oit = orders.begin(); oit != orders.end(); ++oit) {
-        if ((*oit)->id == id) {
-            m_order_pool.release(*oit); // ✅ освобождаем в пул
-            orders.erase(oit);
-            return true;
-        }
+    // Приоритет теряется: тот же слот снимается с уровня и встаёт заново, без release/acquire
+    level.reserve -= order->reserve;
+    level.unlink(m_order_pool, slot);
+    if (level.count == 0 && level.tombstones) compact_level(level);
+    fold_level(side, t, level);
+    mark_dirty(side, t, level);
+    if (level.empty()) ladder.mark_empty(t);
+
+    int remaining = new_qty;
+    order->price_cents = new_price;
+    order->reserve = 0;
+    // Новая цена может пересечь спред — тогда сначала сопоставление, как у входящей лимитки
+    if (side == BookSide::bid) match<Side::buy, OrderType::limit>(remaining, new_price, id, units_transacted, total_value, sink);
+    else match<Side::sell, OrderType::limit>(remaining, new_price, id, units_transacted, total_value, sink);
+
+    if (remaining > 0) {
+        m_order_pool.quantity(slot) = remaining;
+        rest_order(order, sink);
+    } else {
+        unlink_owner(slot);
+        m_order_pool.release(order);
     }
-    return false;
+    return true;
 }
 
-// Template function to print a leg (bid or ask) of the order book.
-template<typename T>
-void Orderbook::print_leg(map<double, deque<unique_ptr<Order>>, T>& hashmap, BookSide side) {
-    if (side == BookSide::ask) {
-        for (auto it = hashmap.rbegin(); it != hashmap.rend(); ++it) { // iterate over price levels
-            int size_sum = 0;
-            for (auto& order : it->second) {
-                size_sum += order->quantity;
-            }
-            string color = "31"; // red for asks
-            cout << "\t\033[1;" << color << "m" << "$" << setw(6) << fixed << setprecision(2)
-                 << it->first << setw(5) << size_sum << "\033[0m ";
-            for (int i = 0; i < size_sum / 10; i++) {
-                cout << "█";
-            }
-            cout << "\n";
+template <typename Sink>
+bool Orderbook::delete_order(uint64_t id, Sink& sink) {
+    Order* order = m_order_pool.find(id);
+    if (!order) return false;
+
+    sink.on_event({id, 0, order->price_cents, m_order_pool.quantity(order_id_slot(id)), EventType::cancel, order->side});
+
+    BookSide side = order->side;
+    size_t t = price_index(order->price_cents);
+    auto& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    PriceLevel& level = *ladder.find(t);
+
+    fold_level(side, t, level);
+    level.reserve -= order->reserve;
+    m_stats.add(BookCounters::orders_cancelled);
+    unlink_owner(order_id_slot(id));
+    if (m_config.cancel_policy == CancelPolicy::tombstone) {
+        // O(1): ордер гаснет на месте, слот вернётся, когда его снимут с уровня
+        level.bury(m_order_pool, order_id_slot(id));
+        m_order_pool.bury(order);
+        queue_compaction(side, t, level);
+        if (needs_compaction(level)) compact_level(level);
+    } else {
+        level.unlink(m_order_pool, order_id_slot(id));
+        m_order_pool.release(order); // ✅ освобождаем в пул
+    }
+    fold_level(side, t, level);
+    mark_dirty(side, t, level);
+    if (level.empty()) {
+        ladder.mark_empty(t);
+    }
+    return true;
+}
+
+template <typename Sink>
+size_t Orderbook::cancel_all(BookSide side, Sink& sink) {
+    auto& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    size_t cancelled = 0;
+    for (size_t t = ladder.first(); t != PriceLadder::npos; t = ladder.next(t + 1)) {
+        PriceLevel& level = *ladder.find(t);
+        for (uint32_t i = level.head; i != NIL_INDEX; i = m_order_pool.next(i)) {
+            const Order& order = m_order_pool[i];
+            if (!order.active) continue;
+            sink.on_event({order.id, 0, order.price_cents, m_order_pool.quantity(i), EventType::cancel, side});
         }
-    } else if (side == BookSide::bid) {
-        for (auto it = hashmap.begin(); it != hashmap.end(); ++it) {
-            int size_sum = 0;
-            for (auto& order : it->second) {
-                size_sum += order->quantity;
-            }
-            string color = "32"; // green for bids
-            cout << "\t\033[1;" << color << "m" << "$" << setw(6) << fixed << setprecision(2)
-                 << it->first << setw(5) << size_sum << "\033[0m ";
-            for (int i = 0; i < size_sum / 10; i++) {
-                cout << "█";
-            }
-            cout << "\n";
+        // Очередь уровня уже связана по next — в пул она уходит целиком
+        cancelled += level.count;
+        fold_level(side, t, level); // пустой уровень вклада не даёт
+        m_order_pool.release_chain(level.head, level.tail, level.count + level.tombstones);
+        level.clear();
+        mark_dirty(side, t, level);
+        ladder.mark_empty(t);
+    }
+    // Списки владельцев на этой стороне опустели целиком
+    for (OwnerOrders& owner : m_owners) owner.head[static_cast<int>(side)] = NIL_INDEX;
+    m_stats.add(BookCounters::orders_cancelled, cancelled);
+    return cancelled;
+}
+
+template <typename Sink>
+size_t Orderbook::cancel_owner_side(uint32_t owner, BookSide side, Sink& sink) {
+    if (!owner || owner >= m_owners.size()) return 0;
+    uint32_t& head = m_owners[owner].head[static_cast<int>(side)];
+    auto& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+
+    // Снятые слоты сцепляем по next (с уровня они уже сняты) и отдаём пулу одним вызовом
+    uint32_t first = NIL_INDEX, last = NIL_INDEX;
+    size_t cancelled = 0;
+    for (uint32_t slot = head; slot != NIL_INDEX;) {
+        Order& order = m_order_pool[slot];
+        uint32_t following = order.owner_next;
+        sink.on_event({order.id, 0, order.price_cents, m_order_pool.quantity(slot), EventType::cancel, side});
+
+        size_t t = price_index(order.price_cents);
+        PriceLevel& level = *ladder.find(t);
+        fold_level(side, t, level);
+        level.reserve -= order.reserve;
+        level.unlink(m_order_pool, slot);
+        if (level.tombstones && needs_compaction(level)) compact_level(level);
+        fold_level(side, t, level);
+        mark_dirty(side, t, level);
+        if (level.empty()) ladder.mark_empty(t);
+
+        order.owner_prev = order.owner_next = NIL_INDEX;
+        if (last == NIL_INDEX) last = slot;
+        else m_order_pool.next(slot) = first;
+        first = slot;
+        ++cancelled;
+        slot = following;
+    }
+    head = NIL_INDEX;
+    if (cancelled) m_order_pool.release_chain(first, last, cancelled);
+    m_stats.add(BookCounters::orders_cancelled, cancelled);
+    return cancelled;
+}
+
+size_t Orderbook::compact_level(PriceLevel& level) {
+    size_t removed = 0;
+    for (uint32_t i = level.head; i != NIL_INDEX && level.tombstones;) {
+        uint32_t next = m_order_pool.next(i);
+        if (!m_order_pool[i].active) {
+            level.drop_tombstone(m_order_pool, i);
+            m_order_pool.reclaim(i);
+            ++removed;
         }
+        i = next;
     }
+    return removed;
+}
+
+size_t Orderbook::compact_side(BookSide side, size_t& budget) {
+    PriceLadder& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    std::vector<size_t>& queued = (side == BookSide::bid) ? m_compact_bids : m_compact_asks;
+
+    size_t removed = 0;
+    while (budget && !queued.empty()) {
+        size_t t = queued.back();
+        queued.pop_back();
+        // Опустевший overflow-уровень мог исчезнуть вместе с флагом
+        PriceLevel* level = ladder.find(t);
+        if (!level || !level->compact_queued) continue;
+        level->compact_queued = false;
+        removed += compact_level(*level);
+        --budget;
+    }
+    return removed;
+}
+
+size_t Orderbook::compact(size_t max_levels) {
+    size_t removed = compact_side(BookSide::bid, max_levels);
+    return removed + compact_side(BookSide::ask, max_levels);
+}
+
+const Order* Orderbook::order_at(BookSide side, int32_t price_cents, size_t n) const {
+    if (!in_band(price_cents)) return nullptr;
+    const auto& ladder = (side == BookSide::bid) ? m_bids : m_asks;
+    const PriceLevel* level = ladder.find(price_index(price_cents));
+    if (!level) return nullptr;
+    // Надгробия ленивой отмены не считаются
+    uint32_t i = level->head;
+    while (i != NIL_INDEX && !m_order_pool[i].active) i = m_order_pool.next(i);
+    while (i != NIL_INDEX && n-- > 0) {
+        do i = m_order_pool.next(i);
+        while (i != NIL_INDEX && !m_order_pool[i].active);
+    }
+    return i == NIL_INDEX ? nullptr : &m_order_pool[i];
 }
 
 // void Orderbook::print() {
@@ -300,143 +735,133 @@ void Orderbook::print_leg(map<double, deque<unique_ptr<Order>>, T>& hashmap, Boo
 //     cout << "==============================\n\n\n";
 // }
 
-// Для покупок (bids) — идём от высоких цен к низким
-std::pair<int, double> Orderbook::fill_bids(int& order_quantity, int limit_price, int& units_transacted, double& total_value) {
-    if (m_active_bids.empty()) {
-        return {units_transacted, total_value};
-    }
-
-    // Используем reverse_iterator для прохода от высоких цен к низким
-    for (auto it = m_active_bids.rbegin(); it != m_active_bids.rend(); ) {
-        int price_cents = *it;
-
-        // Если лимит задан и цена bid ниже лимита продавца — выходим (рыночный ордер sell)
-        if (limit_price > 0 && price_cents < limit_price) {
-            break;
+// Маркер «следующий уровень ещё не искали» (npos уже занят под «нет уровня»)
+static const size_t NOT_SEARCHED = PriceLadder::npos - 1;
+
+// Единое ядро сопоставления: покупка идёт по ask снизу вверх, продажа — по bid
+// сверху вниз; у рыночных ордеров проверки лимита нет вовсе
+template <Side S, OrderType T, typename Sink>
+void Orderbook::match(int& order_quantity, int32_t limit_price, uint64_t taker_id,
+                      int& units_transacted, int64_t& total_value, Sink& sink) {
+    constexpr BookSide maker_side = (S == Side::buy) ? BookSide::ask : BookSide::bid;
+    PriceLadder& ladder = (maker_side == BookSide::ask) ? m_asks : m_bids;
+
+    // Следующий занятый уровень хуже t для тейкера
+    auto further = [&ladder](size_t t) {
+        if constexpr (S == Side::buy) return ladder.next(t + 1);
+        else return t ? ladder.prev(t - 1) : PriceLadder::npos;
+    };
+
+    size_t t = (S == Side::buy) ? ladder.first() : ladder.last();
+    bool emptied = false;
+    uint64_t levels = 0; // для счётчиков; без ORDERBOOK_STATS выбрасывается
+
+    while (t != PriceLadder::npos) {
+        int price_cents = index_price(t);
+
+        // Цена уровня хуже лимита — дальше только хуже
+        if constexpr (T == OrderType::limit) {
+            if (S == Side::buy ? price_cents > limit_price : price_cents < limit_price) break;
         }
 
-        size_t idx = price_cents - MIN_PRICE_CENTS;
-        auto& orders = m_bids[idx];
+        PriceLevel& level = *ladder.find(t);
+        fold_level(maker_side, t, level);
+        ++levels;
 
-        while (!orders.empty() && order_quantity > 0) {
-            auto& current_order = orders.front();
-            int available_qty = current_order->quantity;
-
-            if (available_qty > order_quantity) {
+        // Уровня не хватит — следующий занятый ищем сразу и подтягиваем в кэш,
+        // пока исполняется этот
+        size_t next_t = NOT_SEARCHED;
+        if (m_config.prefetch_distance && level.quantity < order_quantity) {
+            next_t = further(t);
+            if (next_t != PriceLadder::npos) ladder.prefetch(next_t);
+        }
+        // Съедим больше головы — запускаем курсор предвыборки по очереди
+        uint32_t ahead = (order_quantity > m_order_pool.quantity(level.head)) ? prefetch_ahead(level.head) : NIL_INDEX;
+
+        while (!level.empty() && order_quantity > 0) {
+            uint32_t slot = level.head;
+            int& available_qty = m_order_pool.quantity(slot);
+
+            if (available_qty == 0 && !m_order_pool[slot].active) {
+                // Надгробие ленивой отмены: снимаем с головы и идём дальше
+                ahead = prefetch_step(ahead);
+                level.drop_tombstone(m_order_pool, slot);
+                m_order_pool.reclaim(slot);
+                continue;
+            } else if (available_qty > order_quantity) {
                 // Частичное исполнение
                 units_transacted += order_quantity;
-                total_value += (order_quantity * price_cents) / 100.0;
-                current_order->quantity -= order_quantity;
+                total_value += static_cast<int64_t>(order_quantity) * price_cents;
+                available_qty -= order_quantity;
+                level.quantity -= order_quantity;
+                sink.on_event({m_order_pool[slot].id, taker_id, price_cents, order_quantity,
+                               EventType::partial_fill, maker_side});
                 order_quantity = 0;
-                return {units_transacted, total_value};
+                break;
+            } else if (m_order_pool[slot].reserve > 0) {
+                // Видимая часть айсберга съедена: тот же ордер показывает
+                // новую часть из резерва и уходит в хвост уровня
+                Order& iceberg = m_order_pool[slot];
+                units_transacted += available_qty;
+                total_value += static_cast<int64_t>(available_qty) * price_cents;
+                order_quantity -= available_qty;
+                sink.on_event({iceberg.id, taker_id, price_cents, available_qty,
+                               EventType::partial_fill, maker_side});
+
+                ahead = prefetch_step(ahead);
+                level.unlink(m_order_pool, slot);
+                int slice = std::min(iceberg.display, iceberg.reserve);
+                iceberg.reserve -= slice;
+                level.reserve -= slice;
+                available_qty = slice;
+                level.push_back(m_order_pool, slot);
+                sink.on_event({iceberg.id, 0, price_cents, slice, EventType::refresh, maker_side});
             } else {
                 // Полное исполнение встречного ордера
                 units_transacted += available_qty;
-                total_value += (available_qty * price_cents) / 100.0;
+                total_value += static_cast<int64_t>(available_qty) * price_cents;
                 order_quantity -= available_qty;
-
-                // ✅ 1. Возвращаем ордер в пул (ВАЖНО!)
-                m_order_pool.release(current_order);
-
-                orders.pop_front();
-                m_order_metadata.erase(current_order->id);
-
-                // Если уровень цен опустел, удаляем его из активных
-                if (orders.empty()) {
-                    // ✅ 2. Безопасно удаляем по значению, не ломая текущий итератор напрямую
-                    m_active_bids.erase(price_cents);
-
-                    // ✅ 3. Восстанавливаем итератор, так как структура сета изменилась
-                    it = m_active_bids.rbegin();
-
-                    // Обновляем лучший bid
-                    if (price_cents == m_best_bid) {
-                        m_best_bid = m_active_bids.empty() ? 0 : *m_active_bids.rbegin();
-                    }
-                }
+                sink.on_event({m_order_pool[slot].id, taker_id, price_cents, available_qty,
+                               EventType::fill, maker_side});
+
+                ahead = prefetch_step(ahead); // до unlink: курсор не догоняет голову
+                level.unlink(m_order_pool, slot);
+                unlink_owner(slot);
+                m_order_pool.release(&m_order_pool[slot]);
+                m_stats.add(BookCounters::orders_filled);
             }
         }
 
-        // Если уровень не пустой (мы только частично его съели), двигаем итератор дальше
-        if (!orders.empty()) {
-            ++it;
-        }
-
-        if (order_quantity == 0) break;
-    }
-
-    return {units_transacted, total_value};
-}
-
-
-
-std::pair<int, double> Orderbook::fill_asks(int& order_quantity, int limit_price, int& units_transacted, double& total_value) {
-    if (m_active_asks.empty()) {
-        return {units_transacted, total_value};
-    }
-
-    // Используем итератор, а не range-based for
-    for (auto it = m_active_asks.begin(); it != m_active_asks.end(); ) {
-        int price_cents = *it;
-
-        if (limit_price > 0 && price_cents > limit_price) {
-            break;
-        }
-
-        size_t idx = price_cents - MIN_PRICE_CENTS;
-        auto& orders = m_asks[idx];
-
-        while (!orders.empty() && order_quantity > 0) {
-            auto& current_order = orders.front();
-            int available_qty = current_order->quantity;
+        fold_level(maker_side, t, level);
+        mark_dirty(maker_side, t, level);
+        // Живых не осталось — за ними уходят и надгробия
+        if (level.count == 0 && level.tombstones) compact_level(level);
 
-            if (available_qty > order_quantity) {
-                units_transacted += order_quantity;
-                total_value += (order_quantity * price_cents) / 100.0;
-                current_order->quantity -= order_quantity;
-                order_quantity = 0;
-                return {units_transacted, total_value};
-            } else {
-                units_transacted += available_qty;
-                total_value += (available_qty * price_cents) / 100.0;
-                order_quantity -= available_qty;
-                
-                // ✅ ВАЖНО: Не забываем вернуть ордер в пул!
-                m_order_pool.release(current_order);
-
-                orders.pop_front();
-                m_order_metadata.erase(current_order->id);
-
-                if (orders.empty()) {
-                    // ✅ ВАЖНО: Сначала инкрементируем итератор (it++), потом удаляем текущий (erase)
-                    it = m_active_asks.erase(it); 
-                    
-                    if (price_cents == m_best_ask) {
-                        m_best_ask = m_active_asks.empty() ? (MAX_PRICE_CENTS + 1) : *m_active_asks.begin();
-                    }
-                } 
-            }
-        }
-        
-        // Если мы не удалили элемент (уровень не стал пустым), двигаем итератор вручную
-        if (!orders.empty()) {
-             ++it;
+        // Уровень опустел — снимаем его и идём к следующему занятому
+        if (level.empty()) {
+            ladder.mark_empty(t);
+            emptied = true;
         }
 
         if (order_quantity == 0) break;
+        t = (next_t != NOT_SEARCHED) ? next_t : further(t);
     }
 
-    return {units_transacted, total_value};
+    if (levels) {
+        m_stats.add(BookCounters::aggressive_orders);
+        m_stats.add(BookCounters::levels_swept, levels);
+        m_stats.raise(BookCounters::max_levels_swept, levels);
+    }
+    if (emptied) maybe_recenter(maker_side);
 }
+
 void Orderbook::print_bids() {
-    for (int price_cents = MIN_PRICE_CENTS; price_cents <= MAX_PRICE_CENTS; ++price_cents) {
-        auto& orders = m_bids[price_cents - MIN_PRICE_CENTS];
-        if (orders.empty()) continue;
+    // Занятые уровни снизу вверх
+    for (size_t t = m_bids.first(); t != PriceLadder::npos; t = m_bids.next(t + 1)) {
+        int price_cents = index_price(t);
+        const PriceLevel& level = *m_bids.find(t);
 
-        int size_sum = 0;
-        for (auto& order : orders) {
-            size_sum += order->quantity;
-        }
+        int size_sum = static_cast<int>(level.quantity);
 
         double price = price_cents / 100.0;
         cout << "\t\033[1;32m$" << setw(6) << fixed << setprecision(2)
@@ -447,14 +872,12 @@ void Orderbook::print_bids() {
 }
 
 void Orderbook::print_asks() {
-    for (int price_cents = MAX_PRICE_CENTS; price_cents >= MIN_PRICE_CENTS; --price_cents) {
-        auto& orders = m_asks[price_cents - MIN_PRICE_CENTS];
-        if (orders.empty()) continue;
+    // Занятые уровни сверху вниз
+    for (size_t t = m_asks.last(); t != PriceLadder::npos; t = t ? m_asks.prev(t - 1) : PriceLadder::npos) {
+        int price_cents = index_price(t);
+        const PriceLevel& level = *m_asks.find(t);
 
-        int size_sum = 0;
-        for (auto& order : orders) {
-            size_sum += order->quantity;
-        }
+        int size_sum = static_cast<int>(level.quantity);
 
         double price = price_cents / 100.0;
         cout << "\t\033[1;31m$" << setw(6) << fixed << setprecision(2)
@@ -477,4 +900,17 @@ void Orderbook::print() {
 
     print_bids();
     cout << "==============================\n\n\n";
-}
\ No newline at end of file
+}
+
+// Sinks supported by the templated API
+#define ORDERBOOK_INSTANTIATE_SINK(Sink) \
+    template uint64_t Orderbook::add_order<Sink>(int, int32_t, BookSide, uint32_t, Sink&); \
+    template std::pair<int, int64_t> Orderbook::handle_order<Sink>(OrderType, int, Side, int32_t, TimeInForce, int, uint32_t, Sink&); \
+    template bool Orderbook::modify_order<Sink>(uint64_t, int, Sink&); \
+    template bool Orderbook::replace_order<Sink>(uint64_t, int, int32_t, int&, int64_t&, Sink&); \
+    template bool Orderbook::delete_order<Sink>(uint64_t, Sink&); \
+    template size_t Orderbook::cancel_all<Sink>(BookSide, Sink&); \
+    template size_t Orderbook::cancel_owner_side<Sink>(uint32_t, BookSide, Sink&);
+
+ORDERBOOK_INSTANTIATE_SINK(NullSink)
+ORDERBOOK_INSTANTIATE_SINK(EventRing)
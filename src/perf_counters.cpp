@@ -0,0 +1,91 @@
+/**
+ * @file perf_counters.cpp
+ * @brief This file contains the implementation of the PerfCounters class.
+ */
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../include/perf_counters.hpp"
+
+namespace {
+
+int open_event(uint32_t type, uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1; // группа стартует по лидеру
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+constexpr uint64_t DTLB_READ_MISS = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+    m_fds.fill(-1);
+    m_fds[cycles] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (m_fds[cycles] < 0) {
+        m_fds[cycles] = -1;
+        return;
+    }
+    int leader = m_fds[cycles];
+    m_fds[instructions] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+    m_fds[cache_misses] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, leader);
+    m_fds[dtlb_misses] = open_event(PERF_TYPE_HW_CACHE, DTLB_READ_MISS, leader);
+    for (int& fd : m_fds) {
+        if (fd < 0) fd = -1;
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : m_fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void PerfCounters::start() {
+    if (!available()) return;
+    ioctl(m_fds[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_fds[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::stop() {
+    if (!available()) return;
+    ioctl(m_fds[cycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::Reading PerfCounters::read() const {
+    Reading reading;
+    if (!available()) return reading;
+
+    // PERF_FORMAT_GROUP | ID: nr, time_enabled, time_running, затем (value, id) на событие
+    uint64_t buffer[3 + 2 * EVENT_COUNT] = {};
+    if (::read(m_fds[cycles], buffer, sizeof(buffer)) <= 0) return reading;
+    uint64_t nr = buffer[0], enabled = buffer[1], running = buffer[2];
+    double scale = (running && running < enabled) ? static_cast<double>(enabled) / running : 1.0;
+
+    uint64_t ids[EVENT_COUNT] = {};
+    for (int e = 0; e < EVENT_COUNT; ++e) {
+        if (m_fds[e] >= 0) ioctl(m_fds[e], PERF_EVENT_IOC_ID, &ids[e]);
+    }
+    for (uint64_t i = 0; i < nr && i < EVENT_COUNT; ++i) {
+        uint64_t value = buffer[3 + 2 * i], id = buffer[4 + 2 * i];
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            if (m_fds[e] >= 0 && ids[e] == id) {
+                reading.value[e] = static_cast<uint64_t>(value * scale);
+                reading.valid[e] = true;
+            }
+        }
+    }
+    return reading;
+}
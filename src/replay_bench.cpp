@@ -0,0 +1,126 @@
+/**
+ * @file replay_bench.cpp
+ * @brief Streams a recorded message file through the book and reports
+ * throughput and per-message-type latency.
+ *
+ * Usage: ./replay_bench [journal] [--messages=N] [--write=path] [--dump]
+ *
+ * The input is a command journal (see journal.hpp), mapped read-only and
+ * fed to the book without copying. Without one, a synthetic flow with
+ * near-touch prices and a heavy cancel ratio is generated before anything
+ * is timed (flow_generator.hpp); --write saves it as a journal to replay later.
+ * --dump writes replay_<type>_hist.bin for plot_dists.py.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../include/flow_generator.hpp"
+#include "../include/helpers.hpp"
+#include "../include/journal.hpp"
+#include "../include/orderbook.hpp"
+
+using namespace std;
+
+namespace {
+
+enum MessageType { ADD, EXECUTE, MODIFY, CANCEL, MESSAGE_TYPES };
+const char* const MESSAGE_NAMES[MESSAGE_TYPES] = {"add", "execute", "modify", "cancel"};
+
+MessageType message_type(const Command& cmd) {
+    switch (cmd.type) {
+    case CommandType::modify:
+    case CommandType::replace: return MODIFY;
+    case CommandType::cancel:
+    case CommandType::mass_cancel: return CANCEL;
+    default: return cmd.order_type == OrderType::market ? EXECUTE : ADD;
+    }
+}
+
+void report(const char* name, const LatencyHistogram& h) {
+    cout << "  " << left << setw(8) << name << right << setw(10) << h.count()
+         << "  p50 " << setw(6) << h.percentile(0.50)
+         << "  p90 " << setw(6) << h.percentile(0.90)
+         << "  p99 " << setw(6) << h.percentile(0.99)
+         << "  p99.9 " << setw(7) << h.percentile(0.999)
+         << "  max " << h.max() << " ns\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    FlowConfig flow;
+    const char* input = nullptr;
+    const char* output = nullptr;
+    bool dump = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--messages=", 11) == 0) flow.messages = std::strtoul(argv[i] + 11, nullptr, 10);
+        else if (std::strncmp(argv[i], "--write=", 8) == 0) output = argv[i] + 8;
+        else if (std::strcmp(argv[i], "--dump") == 0) dump = true;
+        else input = argv[i];
+    }
+
+    BookConfig config;
+    unique_ptr<JournalReader> reader;
+    vector<Command> generated;
+    span<const Command> messages;
+    if (input) {
+        reader = make_unique<JournalReader>(input);
+        reader->book_config(config);
+        messages = reader->records();
+        cout << "Replaying " << messages.size() << " messages from " << input << "\n";
+    } else {
+        generated = generate_flow(flow, config);
+        messages = generated;
+        cout << "Generated " << messages.size() << " synthetic messages (seed " << flow.seed << ")\n";
+        if (output) {
+            std::remove(output);
+            Journal journal(output, messages.size(), Journal::Options{0});
+            journal.record_book_config(config);
+            for (const Command& cmd : messages) journal.append(cmd);
+            journal.sync();
+            cout << "Wrote " << output << "\n";
+        }
+    }
+
+    size_t counts[MESSAGE_TYPES] = {};
+    for (const Command& cmd : messages) ++counts[message_type(cmd)];
+    cout << "Mix:";
+    for (int t = 0; t < MESSAGE_TYPES; ++t) {
+        cout << " " << MESSAGE_NAMES[t] << " " << fixed << setprecision(1)
+             << (messages.empty() ? 0.0 : 100.0 * counts[t] / messages.size()) << "%";
+    }
+    cout << "\n";
+
+    // 1) Throughput: the whole stream through process_batch, nothing timed per message
+    {
+        Orderbook book(config);
+        uint64_t t0 = unix_time();
+        size_t applied = replay_journal(messages, book);
+        uint64_t ns = unix_time() - t0;
+        cout << "Throughput: " << setprecision(2) << (ns ? applied * 1e3 / ns : 0.0) << " M messages/s ("
+             << applied << " in " << ns / 1e6 << " ms)\n";
+    }
+
+    // 2) Latency: one execute() per message, bucketed by message type
+    {
+        Orderbook book(config);
+        auto histograms = make_unique<LatencyHistogram[]>(MESSAGE_TYPES);
+        cout << "Latency per message type (TSC at " << setprecision(2) << TscClock::ghz() << " GHz):\n";
+
+        for (const Command& cmd : messages) {
+            PROFILE_SCOPE(histograms[message_type(cmd)]);
+            book.execute(cmd);
+        }
+
+        for (int t = 0; t < MESSAGE_TYPES; ++t) {
+            report(MESSAGE_NAMES[t], histograms[t]);
+            if (dump) histograms[t].write(string("replay_") + MESSAGE_NAMES[t] + "_hist.bin");
+        }
+    }
+    return 0;
+}
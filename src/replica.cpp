@@ -0,0 +1,50 @@
+/**
+ * @file replica.cpp
+ * @brief This file contains the implementation of the Replica class.
+ */
+
+#include <algorithm>
+#include "../include/replica.hpp"
+
+// Сколько записей журнала за раз отдаём apply_in_order при догоне
+static const size_t CATCH_UP_BATCH = 256;
+
+Replica::Status Replica::apply(uint64_t sequence, const Command& cmd) {
+    if (m_diverged_at) return Status::diverged;
+    if (sequence < m_next) return Status::duplicate;
+    if (sequence > m_next) return Status::gap;
+
+    Result result = m_book.execute(cmd);
+    ++m_next;
+    if (cmd.type == CommandType::checkpoint && !result.ok) {
+        m_diverged_at = sequence;
+        return Status::diverged;
+    }
+    return Status::applied;
+}
+
+size_t Replica::catch_up(std::span<const Command> journal) {
+    Result results[CATCH_UP_BATCH];
+    size_t applied = 0;
+    while (!m_diverged_at && m_next - 1 < journal.size()) {
+        size_t begin = m_next - 1;
+        size_t n = std::min(CATCH_UP_BATCH, journal.size() - begin);
+        // Пачка заканчивается на checkpoint: расхождение ловится ровно на нём
+        for (size_t i = 0; i < n; ++i) {
+            if (journal[begin + i].type == CommandType::checkpoint) {
+                n = i + 1;
+                break;
+            }
+        }
+        m_book.apply_in_order(journal.subspan(begin, n), {results, n});
+        m_next += n;
+        applied += n;
+        if (journal[begin + n - 1].type == CommandType::checkpoint && !results[n - 1].ok) m_diverged_at = m_next - 1;
+    }
+    return applied;
+}
+
+void Replica::restore(const std::string& snapshot_path) {
+    m_next = m_book.load_snapshot(snapshot_path) + 1;
+    m_diverged_at = 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file shard_bench.cpp
+ * @brief Scaling of the sharded engine with the number of workers.
+ *
+ * Usage: ./shard_bench [--symbols=N] [--messages=N] [--max-workers=N]
+ *
+ * Every symbol gets its own synthetic flow (flow_generator.hpp, seed = symbol),
+ * so symbols are fully independent. For 1, 2, 4, ... max-workers workers the
+ * router (this thread) interleaves all flows symbol by symbol while a
+ * consumer thread drains results; reported is end-to-end throughput and the
+ * speedup over one worker. The router and the consumer each take a core, so
+ * near-linear scaling needs workers + 2 cores.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../include/flow_generator.hpp"
+#include "../include/helpers.hpp"
+#include "../include/sharded_engine.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    size_t symbols = 64;
+    size_t messages = 4'000'000;
+    size_t max_workers = 16;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--symbols=", 10) == 0) symbols = std::strtoul(argv[i] + 10, nullptr, 10);
+        else if (std::strncmp(argv[i], "--messages=", 11) == 0) messages = std::strtoul(argv[i] + 11, nullptr, 10);
+        else if (std::strncmp(argv[i], "--max-workers=", 14) == 0) max_workers = std::strtoul(argv[i] + 14, nullptr, 10);
+    }
+    if (symbols == 0 || max_workers == 0) return 1;
+
+    BookConfig config;
+    config.min_price_cents = 5000;
+    config.max_price_cents = 15000;
+    config.pool_capacity = 1 << 16;
+
+    FlowConfig flow;
+    flow.messages = messages / symbols;
+    vector<vector<Command>> flows(symbols);
+    for (size_t s = 0; s < symbols; ++s) {
+        flow.seed = s + 1;
+        flows[s] = generate_flow(flow, config);
+    }
+    size_t total = flow.messages * symbols;
+    cout << symbols << " symbols x " << flow.messages << " messages, "
+         << std::thread::hardware_concurrency() << " hardware threads\n";
+    cout << setw(8) << "workers" << setw(14) << "M msgs/s" << setw(10) << "speedup" << setw(12) << "efficiency\n";
+
+    double base = 0.0;
+    for (size_t workers = 1; workers <= max_workers; workers *= 2) {
+        ShardedEngine::Options options;
+        options.workers = workers;
+        ShardedEngine engine(options);
+        for (size_t s = 0; s < symbols; ++s) engine.add_symbol(static_cast<uint32_t>(s), config);
+        engine.start();
+
+        uint64_t t0 = unix_time();
+        std::thread consumer([&] {
+            ShardResult result;
+            for (size_t got = 0; got < total;) {
+                if (engine.poll(result)) ++got;
+                else cpu_relax();
+            }
+        });
+        for (size_t i = 0; i < flow.messages; ++i) {
+            for (size_t s = 0; s < symbols; ++s) {
+                while (!engine.submit(static_cast<uint32_t>(s), flows[s][i])) cpu_relax();
+            }
+        }
+        consumer.join();
+        uint64_t ns = unix_time() - t0;
+        engine.stop();
+
+        double rate = ns ? total * 1e3 / ns : 0.0;
+        if (workers == 1) base = rate;
+        cout << setw(8) << workers << setw(14) << fixed << setprecision(2) << rate
+             << setw(9) << setprecision(2) << (base ? rate / base : 0.0) << "x"
+             << setw(10) << setprecision(0) << (base ? 100.0 * rate / base / workers : 0.0) << "%\n";
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file sharded_engine.cpp
+ * @brief This file contains the implementation of the ShardedEngine class.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include "../include/sharded_engine.hpp"
+
+// Как в MatchingEngine: сколько пустых проходов до yield и сколько сообщений за проход
+static const int IDLE_SPINS_BEFORE_YIELD = 1024;
+static const int MAX_BURST = 64;
+
+ShardedEngine::ShardedEngine(const Options& options) : m_options(options) {
+    if (options.workers == 0) throw std::invalid_argument("Sharded engine needs at least one worker");
+    size_t cores = std::thread::hardware_concurrency();
+    for (size_t i = 0; i < options.workers; ++i) {
+        int cpu = i < options.cpus.size() ? options.cpus[i] : (i < cores ? static_cast<int>(i) : -1);
+        m_workers.push_back(std::make_unique<Worker>(options.ring_capacity, cpu));
+    }
+}
+
+ShardedEngine::~ShardedEngine() {
+    stop();
+}
+
+void ShardedEngine::add_symbol(uint32_t symbol, const BookConfig& config, int worker) {
+    if (m_handoff) throw std::logic_error("Symbols must be added before start()");
+    if (symbol < m_owner.size() && m_owner[symbol] >= 0) {
+        throw std::invalid_argument("Book already exists for symbol");
+    }
+    if (worker < 0) {
+        worker = 0;
+        for (size_t w = 1; w < m_workers.size(); ++w) {
+            if (m_workers[w]->initial.size() < m_workers[worker]->initial.size()) worker = static_cast<int>(w);
+        }
+    } else if (static_cast<size_t>(worker) >= m_workers.size()) {
+        throw std::invalid_argument("No such worker");
+    }
+
+    if (symbol >= m_owner.size()) {
+        m_owner.resize(symbol + 1, -1);
+        m_routed.resize(symbol + 1, 0);
+        m_moves.resize(symbol + 1, 0);
+    }
+    m_owner[symbol] = worker;
+    m_workers[worker]->initial.emplace_back(symbol, config);
+}
+
+void ShardedEngine::start() {
+    if (m_running.exchange(true)) return;
+    if (!m_handoff) m_handoff = std::make_unique<Handoff[]>(m_owner.size());
+    m_ready.store(0, std::memory_order_relaxed);
+    for (auto& worker : m_workers) worker->thread = std::thread(&ShardedEngine::run, this, std::ref(*worker));
+    while (m_ready.load(std::memory_order_acquire) < m_workers.size()) std::this_thread::yield();
+}
+
+void ShardedEngine::stop() {
+    if (!m_running.exchange(false)) return;
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
+
+void ShardedEngine::push(Worker& worker, const Message& message) {
+    // Управляющие сообщения не теряются: ждём место в кольце
+    while (!worker.inbound.try_push(message)) cpu_relax();
+}
+
+bool ShardedEngine::submit(uint32_t symbol, const Command& cmd) {
+    int owner = worker_of(symbol);
+    if (owner < 0) return false;
+    if (!m_workers[owner]->inbound.try_push({Message::Kind::command, symbol, 0, cmd})) return false;
+    ++m_routed[symbol];
+    return true;
+}
+
+bool ShardedEngine::poll(ShardResult& out) {
+    for (size_t k = 0; k < m_workers.size(); ++k) {
+        Worker& worker = *m_workers[m_poll_next];
+        if (++m_poll_next == m_workers.size()) m_poll_next = 0;
+        if (worker.outbound.try_pop(out)) return true;
+    }
+    return false;
+}
+
+bool ShardedEngine::move_symbol(uint32_t symbol, size_t to) {
+    int from = worker_of(symbol);
+    if (from < 0 || to >= m_workers.size()) return false;
+    if (static_cast<size_t>(from) == to) return true;
+
+    // Старый воркер отдаёт книгу, дойдя до release — после всех уже
+    // отправленных ему команд; новый ждёт её на adopt, до всех последующих
+    uint64_t move = ++m_moves[symbol];
+    push(*m_workers[from], {Message::Kind::release, symbol, move, {}});
+    push(*m_workers[to], {Message::Kind::adopt, symbol, move, {}});
+    m_owner[symbol] = static_cast<int>(to);
+    return true;
+}
+
+bool ShardedEngine::rebalance() {
+    std::vector<uint64_t> load(m_workers.size(), 0);
+    for (size_t s = 0; s < m_owner.size(); ++s) {
+        if (m_owner[s] >= 0) load[m_owner[s]] += m_routed[s];
+    }
+    size_t busiest = 0, idlest = 0;
+    for (size_t w = 1; w < load.size(); ++w) {
+        if (load[w] > load[busiest]) busiest = w;
+        if (load[w] < load[idlest]) idlest = w;
+    }
+
+    // Самый горячий символ самого загруженного воркера
+    size_t hottest = m_owner.size();
+    for (size_t s = 0; s < m_owner.size(); ++s) {
+        if (m_owner[s] == static_cast<int>(busiest) && (hottest == m_owner.size() || m_routed[s] > m_routed[hottest])) {
+            hottest = s;
+        }
+    }
+
+    // Переезд помогает, только если новый максимум меньше старого
+    bool moved = false;
+    if (busiest != idlest && hottest != m_owner.size() && m_routed[hottest] > 0 &&
+        load[idlest] + m_routed[hottest] < load[busiest]) {
+        moved = move_symbol(static_cast<uint32_t>(hottest), idlest);
+    }
+    std::fill(m_routed.begin(), m_routed.end(), 0);
+    return moved;
+}
+
+Orderbook* ShardedEngine::book(uint32_t symbol) {
+    int owner = worker_of(symbol);
+    if (owner < 0) return nullptr;
+    const std::vector<Orderbook*>& books = m_workers[owner]->books;
+    return symbol < books.size() ? books[symbol] : nullptr;
+}
+
+bool ShardedEngine::drain_once(Worker& worker) {
+    bool did_work = false;
+    Message message;
+    for (int i = 0; i < MAX_BURST && worker.inbound.try_pop(message); ++i) {
+        uint32_t symbol = message.symbol;
+        switch (message.kind) {
+        case Message::Kind::command: {
+            ShardResult result{symbol, worker.books[symbol]->execute(message.command)};
+            // Обратное давление, как в MatchingEngine
+            while (!worker.outbound.try_push(result)) cpu_relax();
+            break;
+        }
+        case Message::Kind::release:
+            m_handoff[symbol].book = worker.books[symbol];
+            m_handoff[symbol].move.store(message.move, std::memory_order_release);
+            worker.books[symbol] = nullptr;
+            break;
+        case Message::Kind::adopt:
+            while (m_handoff[symbol].move.load(std::memory_order_acquire) != message.move) cpu_relax();
+            worker.books[symbol] = m_handoff[symbol].book;
+            break;
+        }
+        did_work = true;
+    }
+    return did_work;
+}
+
+void ShardedEngine::run(Worker& worker) {
+    pin_current_thread(worker.cpu);
+
+    // Первое касание из уже привязанного потока: память книг — на узле NUMA
+    // воркера. После перезапуска книги уже есть
+    if (!worker.manager) {
+        worker.manager = std::make_unique<BookManager>(m_options.arena_bytes);
+        worker.books.assign(m_owner.size(), nullptr);
+        for (const auto& [symbol, config] : worker.initial) {
+            worker.books[symbol] = &worker.manager->create_book(symbol, config);
+        }
+    }
+    m_ready.fetch_add(1, std::memory_order_release);
+
+    int idle = 0;
+    while (m_running.load(std::memory_order_relaxed)) {
+        if (drain_once(worker)) {
+            idle = 0;
+        } else if (++idle >= IDLE_SPINS_BEFORE_YIELD) {
+            std::this_thread::yield();
+            idle = 0;
+        } else {
+            cpu_relax();
+        }
+    }
+
+    // Всё, что было принято до stop(), должно быть исполнено
+    while (drain_once(worker)) {}
+}
@@ -0,0 +1,267 @@
+/**
+ * @file snapshot.cpp
+ * @brief This file contains Orderbook::save_snapshot and Orderbook::load_snapshot.
+ *
+ * Layout: a 256-byte header, then 64-byte aligned sections at the offsets it
+ * records: pool orders, pool quantities and next links (SoA only), and for
+ * each side the window levels followed by the overflow levels as (tick,
+ * level) pairs. Everything refers to orders by slot index, so the file can
+ * be mapped at any address.
+ */
+
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/orderbook.hpp"
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'O', 'B', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr uint32_t SNAPSHOT_VERSION = 2; // 2: Order несёт владельца
+
+struct SnapshotSide {
+    uint64_t window_lo;
+    uint64_t window_width;
+    uint64_t overflow_count;
+    uint64_t levels_offset;
+    uint64_t overflow_offset;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t soa;            // 1 — снимок SoA-сборки
+    uint32_t order_size;     // sizeof(Order) и sizeof(PriceLevel) у записавшего
+    uint32_t level_size;
+    int32_t min_price_cents;
+    int32_t max_price_cents;
+    int32_t tick_size;
+    uint32_t reserved0;
+    uint64_t window_ticks;
+    uint64_t pool_slots;
+    uint64_t free_head;
+    uint64_t in_use;
+    uint64_t high_water;
+    uint64_t journal_position;
+    uint64_t orders_offset;
+    uint64_t quantities_offset; // 0 в AoS
+    uint64_t next_offset;
+    SnapshotSide sides[2];   // bid, ask
+    uint8_t reserved[64];
+};
+static_assert(sizeof(SnapshotHeader) == 256, "snapshot header is 256 bytes");
+
+// Уровень вне окна: тик и заголовок (PriceLevel выровнен на 32)
+struct SnapshotOverflow {
+    uint64_t tick;
+    PriceLevel level;
+};
+
+#ifdef ORDERBOOK_SOA
+constexpr uint32_t SNAPSHOT_SOA = 1;
+#else
+constexpr uint32_t SNAPSHOT_SOA = 0;
+#endif
+
+uint64_t align64(uint64_t n) { return (n + 63) & ~uint64_t{63}; }
+
+[[noreturn]] void bad_snapshot(const std::string& path, const char* why) {
+    throw std::runtime_error("snapshot " + path + ": " + why);
+}
+
+// Read-only mapping of the whole file for the duration of a load
+struct MappedFile {
+    void* data = MAP_FAILED;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) bad_snapshot(path, "cannot open");
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size = static_cast<size_t>(st.st_size);
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED) bad_snapshot(path, "cannot map");
+    }
+    ~MappedFile() { munmap(data, size); }
+
+    const char* at(uint64_t offset) const { return static_cast<const char*>(data) + offset; }
+};
+
+} // namespace
+
+void Orderbook::save_snapshot(const std::string& path, uint64_t journal_position) {
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.soa = SNAPSHOT_SOA;
+    header.order_size = sizeof(Order);
+    header.level_size = sizeof(PriceLevel);
+    header.min_price_cents = m_config.min_price_cents;
+    header.max_price_cents = m_config.max_price_cents;
+    header.tick_size = m_config.tick_size;
+    header.window_ticks = m_config.window_ticks;
+    header.pool_slots = m_order_pool.capacity();
+    header.free_head = m_order_pool.free_head();
+    header.in_use = m_order_pool.in_use();
+    header.high_water = m_order_pool.high_water();
+    header.journal_position = journal_position;
+
+    // Смещения секций известны заранее — файл пишется одним проходом
+    uint64_t slots = header.pool_slots;
+    uint64_t offset = sizeof(SnapshotHeader);
+    header.orders_offset = offset;
+    offset = align64(offset + slots * sizeof(Order));
+    if (SNAPSHOT_SOA) {
+        header.quantities_offset = offset;
+        offset = align64(offset + slots * sizeof(int));
+        header.next_offset = offset;
+        offset = align64(offset + slots * sizeof(uint32_t));
+    }
+    PriceLadder* ladders[2] = {&m_bids, &m_asks};
+    for (int s = 0; s < 2; ++s) {
+        SnapshotSide& side = header.sides[s];
+        side.window_lo = ladders[s]->window_lo();
+        side.window_width = ladders[s]->window_width();
+        side.overflow_count = ladders[s]->overflow_levels();
+        side.levels_offset = offset;
+        offset = align64(offset + side.window_width * sizeof(PriceLevel));
+        side.overflow_offset = offset;
+        offset = align64(offset + side.overflow_count * sizeof(SnapshotOverflow));
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) bad_snapshot(path, "cannot create");
+    auto write_at = [&out](uint64_t at, const void* data, size_t bytes) {
+        static const char zeros[64] = {};
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        while (pos < at) {
+            size_t pad = std::min<uint64_t>(at - pos, sizeof(zeros));
+            out.write(zeros, pad);
+            pos += pad;
+        }
+        out.write(static_cast<const char*>(data), bytes);
+    };
+
+    write_at(0, &header, sizeof(header));
+    // Чанки пула идут подряд по индексам, потому каждая секция — сплошной массив
+    m_order_pool.for_each_chunk([&](uint32_t begin, Order* orders, int*, uint32_t*, size_t n) {
+        write_at(header.orders_offset + begin * sizeof(Order), orders, n * sizeof(Order));
+    });
+    if (SNAPSHOT_SOA) {
+        m_order_pool.for_each_chunk([&](uint32_t begin, Order*, int* quantities, uint32_t*, size_t n) {
+            write_at(header.quantities_offset + begin * sizeof(int), quantities, n * sizeof(int));
+        });
+        m_order_pool.for_each_chunk([&](uint32_t begin, Order*, int*, uint32_t* next, size_t n) {
+            write_at(header.next_offset + begin * sizeof(uint32_t), next, n * sizeof(uint32_t));
+        });
+    }
+    for (int s = 0; s < 2; ++s) {
+        const SnapshotSide& side = header.sides[s];
+        write_at(side.levels_offset, ladders[s]->window_data(), side.window_width * sizeof(PriceLevel));
+        uint64_t at = side.overflow_offset;
+        ladders[s]->for_each_overflow([&](size_t t, const PriceLevel& lvl) {
+            SnapshotOverflow entry{};
+            entry.tick = t;
+            entry.level = lvl;
+            write_at(at, &entry, sizeof(entry));
+            at += sizeof(entry);
+        });
+    }
+    if (!out.flush()) bad_snapshot(path, "write failed");
+}
+
+uint64_t Orderbook::load_snapshot(const std::string& path) {
+    MappedFile file(path);
+    if (file.size < sizeof(SnapshotHeader)) bad_snapshot(path, "truncated header");
+    SnapshotHeader header;
+    std::memcpy(&header, file.data, sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION) {
+        bad_snapshot(path, "not a snapshot");
+    }
+    if (header.soa != SNAPSHOT_SOA || header.order_size != sizeof(Order) || header.level_size != sizeof(PriceLevel)) {
+        bad_snapshot(path, "written by a build with a different order layout");
+    }
+    if (header.min_price_cents != m_config.min_price_cents || header.max_price_cents != m_config.max_price_cents ||
+        header.tick_size != m_config.tick_size || header.window_ticks != m_config.window_ticks) {
+        bad_snapshot(path, "book config differs");
+    }
+
+    // Ёмкость пула определяется конфигом и ростом чанками — доращиваем до той же
+    if (m_order_pool.capacity() > header.pool_slots || !m_order_pool.reserve(header.pool_slots) ||
+        m_order_pool.capacity() != header.pool_slots) {
+        bad_snapshot(path, "pool capacity cannot match");
+    }
+    PriceLadder* ladders[2] = {&m_bids, &m_asks};
+    for (int s = 0; s < 2; ++s) {
+        const SnapshotSide& side = header.sides[s];
+        if (side.window_width != ladders[s]->window_width()) bad_snapshot(path, "window width differs");
+        if (side.overflow_offset + side.overflow_count * sizeof(SnapshotOverflow) > file.size) {
+            bad_snapshot(path, "truncated levels");
+        }
+    }
+    uint64_t slots = header.pool_slots;
+    if (header.orders_offset + slots * sizeof(Order) > file.size ||
+        (SNAPSHOT_SOA && header.next_offset + slots * sizeof(uint32_t) > file.size)) {
+        bad_snapshot(path, "truncated pool");
+    }
+
+    m_order_pool.for_each_chunk([&](uint32_t begin, Order* orders, int* quantities, uint32_t* next, size_t n) {
+        std::memcpy(orders, file.at(header.orders_offset + begin * sizeof(Order)), n * sizeof(Order));
+        if (SNAPSHOT_SOA) {
+            std::memcpy(quantities, file.at(header.quantities_offset + begin * sizeof(int)), n * sizeof(int));
+            std::memcpy(next, file.at(header.next_offset + begin * sizeof(uint32_t)), n * sizeof(uint32_t));
+        }
+    });
+    m_order_pool.restore(static_cast<uint32_t>(header.free_head), header.in_use, header.high_water);
+
+    m_dirty_bids.clear();
+    m_dirty_asks.clear();
+    m_compact_bids.clear();
+    m_compact_asks.clear();
+    for (int s = 0; s < 2; ++s) {
+        const SnapshotSide& side = header.sides[s];
+        PriceLadder& ladder = *ladders[s];
+        BookSide book_side = s == 0 ? BookSide::bid : BookSide::ask;
+        PriceLevel* window = ladder.window_data();
+        std::memcpy(window, file.at(side.levels_offset), side.window_width * sizeof(PriceLevel));
+        ladder.restore(side.window_lo);
+
+        const auto* overflow = reinterpret_cast<const SnapshotOverflow*>(file.at(side.overflow_offset));
+        for (uint64_t i = 0; i < side.overflow_count; ++i) {
+            ladder.level(overflow[i].tick) = overflow[i].level;
+        }
+
+        // Подписчики глубины после восстановления получают всю книгу заново;
+        // очередь уплотнения собирается по уровням с надгробиями
+        for (size_t w = 0; w < side.window_width; ++w) window[w].dirty = window[w].compact_queued = false;
+        for (size_t t = ladder.first(); t != PriceLadder::npos; t = ladder.next(t + 1)) {
+            PriceLevel& lvl = ladder.level(t);
+            lvl.dirty = false;
+            mark_dirty(book_side, t, lvl);
+            lvl.compact_queued = false;
+            if (lvl.tombstones) queue_compaction(book_side, t, lvl);
+        }
+    }
+    // Ссылки списков владельцев приехали в Order как есть; ищем только головы.
+    // Перелинковка дала бы другой порядок, и cancel_all(owner) вернул бы
+    // слоты в пул иначе, чем первичная книга, — с другими ID дальше
+    m_owners.clear();
+    for (BookSide book_side : {BookSide::bid, BookSide::ask}) {
+        for_each_order(book_side, [&](const Order& order) {
+            if (!order.owner || order.owner_prev != NIL_INDEX) return;
+            if (order.owner >= m_owners.size()) m_owners.resize(size_t{order.owner} + 1);
+            m_owners[order.owner].head[static_cast<int>(book_side)] = m_order_pool.index_of(&order);
+        });
+    }
+    // Digest тоже выводится из уровней: у реплики он сразу сверяем с первичной книгой
+    m_digest = full_digest();
+    return header.journal_position;
+}
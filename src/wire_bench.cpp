@@ -0,0 +1,110 @@
+/**
+ * @file wire_bench.cpp
+ * @brief Decode cost of the binary order-entry protocol, alone and feeding a book.
+ *
+ * Usage: ./wire_bench [--messages=N] [--rounds=N]
+ *
+ * A synthetic flow (flow_generator.hpp; modifies dropped, they have no wire
+ * form) is encoded once into an 8-aligned buffer. Reported per message:
+ * decode only (a handler that folds a few fields, so nothing is optimized
+ * away; target < 10 ns), decode + direct dispatch to a book, and decode +
+ * process_batch. The book passes replay the buffer into a fresh book each
+ * round.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "../include/flow_generator.hpp"
+#include "../include/tsc_clock.hpp"
+#include "../include/wire_protocol.hpp"
+
+using namespace std;
+
+namespace {
+
+const double DECODE_TARGET_NS = 10.0;
+
+// Складывает поля, чтобы разбор нельзя было выбросить
+struct FoldHandler {
+    uint64_t acc = 0;
+    void on_new_order(const WireNewOrder& m) { acc += m.seq ^ static_cast<uint64_t>(m.price_cents + m.quantity); }
+    void on_cancel(const WireCancel& m) { acc += m.order_id; }
+    void on_replace(const WireReplace& m) { acc += m.order_id ^ static_cast<uint64_t>(m.quantity); }
+    void on_mass_cancel(const WireMassCancel& m) { acc += m.seq; }
+};
+
+void report(const char* name, uint64_t ns, size_t messages) {
+    double per = messages ? static_cast<double>(ns) / messages : 0.0;
+    cout << "  " << left << setw(18) << name << right << setw(8) << fixed << setprecision(2) << per << " ns/msg"
+         << setw(10) << setprecision(1) << (per > 0 ? 1e3 / per : 0.0) << " M msgs/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    FlowConfig flow;
+    flow.messages = 1'000'000;
+    size_t rounds = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--messages=", 11) == 0) flow.messages = std::strtoul(argv[i] + 11, nullptr, 10);
+        else if (std::strncmp(argv[i], "--rounds=", 9) == 0) rounds = std::strtoul(argv[i] + 9, nullptr, 10);
+    }
+    if (rounds == 0) rounds = 1;
+
+    BookConfig config;
+    config.min_price_cents = 5000;
+    config.max_price_cents = 15000;
+    config.pool_capacity = 1 << 20;
+    vector<Command> commands = generate_flow(flow, config);
+
+    vector<uint64_t> storage(commands.size() * 4); // до 32 байт на сообщение
+    std::byte* out = reinterpret_cast<std::byte*>(storage.data());
+    size_t bytes = 0, messages = 0;
+    for (const Command& cmd : commands) {
+        size_t n = encode_message(cmd, 0, out + bytes);
+        bytes += n;
+        messages += n != 0;
+    }
+    std::span<const std::byte> buffer(out, bytes);
+    cout << messages << " messages, " << bytes << " bytes (" << setprecision(1) << fixed
+         << static_cast<double>(bytes) / messages << " B/msg), " << rounds << " rounds, best round\n";
+
+    uint64_t best = UINT64_MAX;
+    FoldHandler fold;
+    for (size_t r = 0; r < rounds; ++r) {
+        uint64_t t0 = tsc_now();
+        decode_messages(buffer, fold);
+        best = std::min(best, TscClock::to_ns(tsc_now() - t0));
+    }
+    report("decode", best, messages);
+    double decode_ns = static_cast<double>(best) / messages;
+
+    best = UINT64_MAX;
+    for (size_t r = 0; r < rounds; ++r) {
+        Orderbook book(config);
+        WireBookDispatcher dispatcher(book);
+        uint64_t t0 = tsc_now();
+        decode_messages(buffer, dispatcher);
+        best = std::min(best, TscClock::to_ns(tsc_now() - t0));
+    }
+    report("decode+book", best, messages);
+
+    best = UINT64_MAX;
+    for (size_t r = 0; r < rounds; ++r) {
+        Orderbook book(config);
+        size_t answered = 0;
+        WireBatchDispatcher batch(book, [&](const Result&) { ++answered; });
+        uint64_t t0 = tsc_now();
+        decode_messages(buffer, batch);
+        batch.flush();
+        best = std::min(best, TscClock::to_ns(tsc_now() - t0));
+    }
+    report("decode+batch", best, messages);
+
+    cout << "decode target < " << DECODE_TARGET_NS << " ns/msg: "
+         << (decode_ns < DECODE_TARGET_NS ? "ok" : "MISSED") << "  (checksum " << fold.acc << ")\n";
+    return 0;
+}
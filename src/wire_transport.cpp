@@ -0,0 +1,59 @@
+/**
+ * @file wire_transport.cpp
+ * @brief This file contains the implementation of the UdpReceiver class.
+ */
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+#include "../include/wire_transport.hpp"
+
+UdpReceiver::UdpReceiver(uint16_t port, const char* addr, size_t batch, size_t datagram_bytes)
+    : m_datagram_bytes((datagram_bytes + 7) / 8 * 8),
+      m_storage(batch * m_datagram_bytes / 8),
+      m_iov(batch),
+      m_headers(batch)
+{
+    if (batch == 0 || datagram_bytes == 0) throw std::invalid_argument("udp: empty receive batch");
+
+    m_fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (m_fd < 0) throw std::system_error(errno, std::generic_category(), "udp: socket");
+
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    if (::inet_pton(AF_INET, addr, &local.sin_addr) != 1) {
+        ::close(m_fd);
+        throw std::invalid_argument("udp: bad address");
+    }
+    socklen_t len = sizeof(local);
+    if (::bind(m_fd, reinterpret_cast<sockaddr*>(&local), len) != 0 ||
+        ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&local), &len) != 0) {
+        int err = errno;
+        ::close(m_fd);
+        throw std::system_error(err, std::generic_category(), "udp: bind");
+    }
+    m_port = ntohs(local.sin_port);
+
+    // Слоты и заголовки собираются один раз, recvmmsg только перезаписывает длины
+    for (size_t i = 0; i < batch; ++i) {
+        m_iov[i].iov_base = const_cast<std::byte*>(slot(i));
+        m_iov[i].iov_len = m_datagram_bytes;
+        m_headers[i].msg_hdr = {};
+        m_headers[i].msg_hdr.msg_iov = &m_iov[i];
+        m_headers[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+UdpReceiver::~UdpReceiver() {
+    if (m_fd >= 0) ::close(m_fd);
+}
+
+int UdpReceiver::receive() {
+    int n = ::recvmmsg(m_fd, m_headers.data(), static_cast<unsigned>(m_headers.size()), MSG_DONTWAIT, nullptr);
+    // EAGAIN — очередь пуста; прочие ошибки сокета для UDP не фатальны
+    return n < 0 ? 0 : n;
+}